@@ -2,6 +2,8 @@
 #include "../src/object.hpp"
 #include "../src/evaluator.hpp"
 #include "../src/parser.hpp"
+#include "../src/hash_cons.hpp"
+#include "../src/inliner.hpp"
 #include <cstdlib>
 #include <iostream>
 #include <string>
@@ -21,7 +23,17 @@ bool check_parser_errors(parser::parser p) {
 bool    parser::trace::_enable_trace = 0;
 size_t  parser::trace::_indent_level = 0;
 
-int main() {
+int main(int argc, char* argv[]) {
+    bool hash_cons = false;
+    bool inline_fns = false;
+    for(int i = 1; i < argc; i++) {
+        if(std::string_view(argv[i]) == "--hash-cons") {
+            hash_cons = true;
+        } else if(std::string_view(argv[i]) == "--inline") {
+            inline_fns = true;
+        }
+    }
+
     std::string input;
     std::ostringstream oss;
 
@@ -36,10 +48,26 @@ int main() {
 
     lexer::lexer l(cstr_input);
     parser::parser p(l);
-    std::shared_ptr<const ast::program> program(p.parse_program());
+    std::shared_ptr<ast::program> program(p.parse_program());
     if(!check_parser_errors(p)) {
         exit(EXIT_FAILURE);
     }
+    if(inline_fns) {
+        ast::inliner::report r = ast::inliner().run(*program);
+        std::cout << "inlining: " << r.inlined << " call sites of " << r.candidates << " candidates";
+        for(const std::string& name : r.functions) {
+            std::cout << " " << name;
+        }
+        std::cout << ", skipped " << r.skipped << std::endl;
+    }
+    if(hash_cons) {
+        ast::hash_consing::report r = ast::hash_consing().run(*program);
+        std::cout
+            << "hash-consing: shared "
+            << r.shared << " of " << r.nodes << " nodes, saved "
+            << r.bytes_saved << " bytes"
+            << std::endl;
+    }
 
     object::scope* scope = new object::scope();
     object::object* evaluated = evaluator::eval(program, scope);
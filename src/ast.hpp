@@ -1,43 +1,119 @@
 #pragma once
 
+#include <charconv>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 #include "token.hpp"
 
+namespace object { class string; }
+
 namespace ast {
 
+/**
+ * Single output buffer that a whole tree is printed into, so that printing is
+ * linear in the size of the tree. In pretty mode blocks are braced and their
+ * statements are put on separate, indented lines.
+ */
+class writer {
+public:
+    writer(bool pretty = false) noexcept : _pretty(pretty) {}
+
+    writer& operator<<(std::string_view s) noexcept { _buf.append(s); return *this; }
+    writer& operator<<(const char* s) noexcept { _buf.append(s); return *this; }
+    writer& operator<<(char c) noexcept { _buf.push_back(c); return *this; }
+    writer& operator<<(std::int64_t v) noexcept { 
+        char digits[24];
+        auto res = std::to_chars(digits, digits + sizeof(digits), v);
+        _buf.append(digits, res.ptr);
+        return *this;
+    }
+
+    bool pretty() const noexcept { return _pretty; }
+    void indent() noexcept { ++_depth; }
+    void dedent() noexcept { --_depth; }
+    void newline() noexcept {
+        if(_pretty) {
+            _buf.push_back('\n');
+            _buf.append(_depth * 4, ' ');
+        }
+    }
+
+    const std::string& str() const noexcept { return _buf; }
+    std::string take() noexcept { return std::move(_buf); }
+
+private:
+    std::string     _buf;
+    bool            _pretty;
+    std::size_t     _depth = 0;
+};
+
+struct node;
+struct statement;
+struct expression;
+class block_statement;
+struct prototype;
+
+/**
+ * Visits the child pointers of a node by reference, so that passes over the tree
+ * can replace subtrees in place.
+ */
+struct child_visitor {
+    virtual ~child_visitor() noexcept = default;
+    virtual void visit(std::shared_ptr<statement>& child) noexcept = 0;
+    virtual void visit(std::shared_ptr<expression>& child) noexcept = 0;
+    virtual void visit(std::shared_ptr<block_statement>& child) noexcept = 0;
+};
+
 struct node {
     node() noexcept = default;
     virtual ~node() noexcept = default;
-    virtual const std::string to_string() const noexcept = 0; // allow std::string for debug statements
-    virtual const std::string_view token_literal() const noexcept = 0;
+    virtual void write(writer& w) const noexcept = 0;
+    virtual const std::string token_literal() const noexcept = 0;
+    virtual void visit_children(child_visitor&) noexcept {}
+
+    const std::string to_string(bool pretty = false) const noexcept { // allow std::string for debug statements
+        writer w(pretty);
+        write(w);
+        return w.take();
+    }
+
+    /**
+     * Location of the token that introduced this node in the source.
+     */
+    const token::span& span() const noexcept { return _span; }
+    void set_span(token::span span) noexcept { _span = span; }
+
+protected:
+    token::span _span;
 };
 
 struct statement : node {
-    virtual const std::string_view token_literal() const noexcept = 0;
+    virtual const std::string token_literal() const noexcept = 0;
 };
 
 struct expression : node {
-    virtual const std::string_view token_literal() const noexcept = 0;
+    virtual const std::string token_literal() const noexcept = 0;
 };
 
 class program : public node {
 public:
-    const std::string_view token_literal() const noexcept override {
+    const std::string token_literal() const noexcept override {
         if(_statements.size() > 0) {
             return _statements[0]->token_literal();
         } else {
             return "";
         }
     }
-    const std::string to_string() const noexcept override {
-        std::string buf;
+    void visit_children(child_visitor& v) noexcept override { for(auto& stmt : _statements) { v.visit(stmt); } }
+    void write(writer& w) const noexcept override {
         for(int i=0;i<_statements.size();i++){
-            statement* stmt = _statements[i].get();
-            buf += stmt->to_string();
+            if(i != 0) { w.newline(); }
+            _statements[i]->write(w);
         }
-        return buf;
     }
     
     const std::vector<std::shared_ptr<statement>>& statements() const noexcept { return _statements; }
@@ -57,7 +133,7 @@ protected:
 class identifier : public expression {
 public:
     identifier() noexcept = default;
-    identifier(token::token token, std::string_view value) noexcept : _token(token), _value(std::string(value)) {}
+    identifier(token::span span, std::string_view value) noexcept : _value(std::string(value)) { _span = span; }
     ~identifier() noexcept = default;
     
     identifier(const identifier& other) noexcept = delete;
@@ -65,18 +141,17 @@ public:
     identifier(identifier&& other) noexcept = default;
     identifier& operator=(identifier&& other) noexcept = default;
 
-    const std::string_view token_literal() const noexcept override { return _token.token_literal(); }
-    const std::string to_string() const noexcept override { return std::string(token_literal()); }
+    const std::string token_literal() const noexcept override { return _value; }
+    void write(writer& w) const noexcept override { w << _value; }
     std::string_view value() const noexcept { return _value; }
 
 protected:
-    token::token    _token;
     std::string     _value;
 };
 
 class let_statement : public statement {
 public:
-    let_statement(token::token token) noexcept : _token(token) {}
+    let_statement(token::span span) noexcept { _span = span; }
     let_statement(const let_statement& other) noexcept = delete;
     let_statement& operator=(const let_statement& other) noexcept = delete;
     ~let_statement() noexcept = default;
@@ -86,101 +161,92 @@ public:
 
     std::shared_ptr<const expression> value() const noexcept { return _value; }
 
-    const std::string_view token_literal() const noexcept override { return _token.token_literal(); }
-    const std::string to_string() const noexcept override { 
-        std::string buf;
-        buf = std::string(token_literal()) + " " + _ident.to_string() + " = ";
+    const std::string token_literal() const noexcept override { return "let"; }
+    void visit_children(child_visitor& v) noexcept override { if(_value != nullptr) { v.visit(_value); } }
+    void write(writer& w) const noexcept override { 
+        w << "let " << _ident.value() << " = ";
         if(_value != nullptr){
-            buf += _value->to_string();
+            _value->write(w);
         }
-        buf += ";";
-        return buf; 
+        w << ";";
     }
 
     const identifier& ident() const noexcept { return _ident; }
-    const token::token& token() const noexcept { return _token; }
 
 protected:
-    token::token                _token;
     identifier                  _ident;
     std::shared_ptr<expression> _value;
 };
 
 class return_statement : public statement { 
 public:
-    return_statement(token::token token) noexcept : _token(token) {}
+    return_statement(token::span span) noexcept { _span = span; }
 
     std::shared_ptr<const expression> return_value() const noexcept { return _return_value; }
     void set_return_value(expression* rv) noexcept { _return_value = std::shared_ptr<expression>(rv); }
 
-    const std::string_view token_literal() const noexcept override { return _token.token_literal(); }
-    const std::string to_string() const noexcept override { 
-        std::string buf;
-        buf = std::string(token_literal()) + " ";
+    const std::string token_literal() const noexcept override { return "return"; }
+    void visit_children(child_visitor& v) noexcept override { if(_return_value != nullptr) { v.visit(_return_value); } }
+    void write(writer& w) const noexcept override { 
+        w << "return ";
         if(_return_value != nullptr){
-            buf += _return_value->to_string();
+            _return_value->write(w);
         }
-        buf += ";";
-        return buf; 
+        w << ";";
     }
     
 protected:
-    token::token                _token;
     std::shared_ptr<expression> _return_value;
 };
 
 class expression_statement : public statement {
 public:    
-    expression_statement(token::token token) noexcept : _token(token) {}
+    expression_statement(token::span span) noexcept { _span = span; }
 
-    const std::string_view token_literal() const noexcept override { return _token.token_literal(); }
-    const std::string to_string() const noexcept override { 
-        std::string buf;
+    const std::string token_literal() const noexcept override { return _expr != nullptr ? _expr->token_literal() : ""; }
+    void visit_children(child_visitor& v) noexcept override { if(_expr != nullptr) { v.visit(_expr); } }
+    void write(writer& w) const noexcept override { 
         if(_expr != nullptr){
-            buf += _expr->to_string();
+            _expr->write(w);
         }
-        return buf; 
+        if(w.pretty()) { w << ";"; }
     }
 
     void move_expr(expression* expr) noexcept { _expr = std::shared_ptr<expression>(expr); }
     std::shared_ptr<const expression> expr() const noexcept { return _expr; } 
 
 protected:
-    token::token                _token; // first token of the expression
     std::shared_ptr<expression> _expr;
 };
 
 class int_literal : public expression {
 public:    
     int_literal() noexcept = default;
-    int_literal(token::token token, std::int64_t value) noexcept : _token(token), _value(value) {}
+    int_literal(token::span span, std::int64_t value) noexcept : _value(value) { _span = span; }
     ~int_literal() noexcept = default;
 
     int_literal(const int_literal& other) noexcept = delete;
     int_literal& operator=(const int_literal& other) noexcept = delete;
 
-    const std::string_view token_literal() const noexcept override { return _token.token_literal(); }
-    const std::string to_string() const noexcept override { return std::to_string(_value); }
+    const std::string token_literal() const noexcept override { return std::to_string(_value); }
+    void write(writer& w) const noexcept override { w << _value; }
     std::int64_t value() const noexcept { return _value; }
 
 protected:
-    token::token    _token; 
     std::int64_t    _value;
 };
 
 class prefix_expression : public expression {
 public:
     prefix_expression() noexcept = default;
-    prefix_expression(token::token token, std::string_view op) noexcept : _token(token), _op(std::string(op)) {}
-
-    const std::string_view token_literal() const noexcept override { return _token.token_literal(); }
-    const std::string to_string() const noexcept override {
-        std::string buf;
-        buf += "(";
-        buf += std::string(_op);
-        buf += _expr->to_string();
-        buf += ")";
-        return buf;
+    prefix_expression(token::span span, std::string_view op) noexcept : _op(std::string(op)) { _span = span; }
+
+    const std::string token_literal() const noexcept override { return _op; }
+    void visit_children(child_visitor& v) noexcept override { v.visit(_expr); }
+    void write(writer& w) const noexcept override {
+        w << "(" << _op;
+        _expr->write(w);
+        w << ")";
     }
 
     std::string_view op() const noexcept { return _op; }
@@ -188,7 +254,6 @@ public:
     void set_expr(expression* expr) noexcept { _expr = std::shared_ptr<expression>(expr); }
     
 protected:
-    token::token                    _token;
     std::string                     _op;
     std::shared_ptr<expression>     _expr; 
 };
@@ -196,18 +261,20 @@ protected:
 class infix_expression : public expression {
 public: 
     infix_expression() noexcept = default;
-    infix_expression(token::token token, std::string_view op, expression* l_expr) noexcept
-        : _token(token), _op(std::string(op)), _l_expr(l_expr) {}
+    infix_expression(token::span span, std::string_view op, expression* l_expr) noexcept
+        : _op(std::string(op)), _l_expr(l_expr) { _span = span; }
 
-    const std::string_view token_literal() const noexcept override { return _token.token_literal(); }
-    const std::string to_string() const noexcept override {
-        std::string buf;
-        buf += "(";
-        buf += _l_expr->to_string();
-        buf += " " + std::string(_op) + " ";
-        buf += _r_expr->to_string();
-        buf += ")";
-        return buf;
+    const std::string token_literal() const noexcept override { return _op; }
+    void visit_children(child_visitor& v) noexcept override {
+        v.visit(_l_expr);
+        v.visit(_r_expr);
+    }
+    void write(writer& w) const noexcept override {
+        w << "(";
+        _l_expr->write(w);
+        w << " " << _op << " ";
+        _r_expr->write(w);
+        w << ")";
     }
 
     std::string_view op() const noexcept { return _op; }
@@ -217,7 +284,6 @@ public:
     void right_expr(expression* r_expr) { _r_expr = std::shared_ptr<expression>(r_expr); }
 
 protected:
-    token::token                    _token; // the operator token (e.g. +, -, etc.)
     std::string                     _op;
     std::shared_ptr<expression>     _l_expr;
     std::shared_ptr<expression>     _r_expr;
@@ -226,42 +292,54 @@ protected:
 class boolean : public expression {
 public:
     boolean() noexcept = default;
-    boolean(token::token token, bool value) noexcept : _token(token), _value(value) {};
+    boolean(token::span span, bool value) noexcept : _value(value) { _span = span; }
     
     const bool value() const noexcept { return _value; }
 
-    const std::string_view token_literal() const noexcept override { return _token.token_literal(); }
-    const std::string to_string() const noexcept override { return std::string(_token.token_literal()); }
+    const std::string token_literal() const noexcept override { return _value ? "true" : "false"; }
+    void write(writer& w) const noexcept override { w << (_value ? "true" : "false"); }
     
 protected:
-    token::token    _token; 
     bool            _value;
 };
 
 class block_statement : public statement {
 public:
+    block_statement() noexcept = default;
+    block_statement(token::span span) noexcept { _span = span; }
+
     const std::vector<std::shared_ptr<statement>>& statements() const noexcept { return _statements; }
 
     void add_statement(statement* stmt) noexcept { _statements.push_back(std::shared_ptr<statement>(stmt)); }
 
-    const std::string_view token_literal() const noexcept override { return _token.token_literal(); }
-    const std::string to_string() const noexcept override {
-        std::string buf;
+    const std::string token_literal() const noexcept override { return "{"; }
+    void visit_children(child_visitor& v) noexcept override { for(auto& stmt : _statements) { v.visit(stmt); } }
+    void write(writer& w) const noexcept override {
+        if(w.pretty()) {
+            w << "{";
+            w.indent();
+            for(int i=0;i<_statements.size();i++){
+                w.newline();
+                _statements[i]->write(w);
+            }
+            w.dedent();
+            w.newline();
+            w << "}";
+            return;
+        }
         for(int i=0;i<_statements.size();i++){
-            buf += _statements[i]->to_string();
+            _statements[i]->write(w);
         }
-        return buf;
     }
 
 protected:
-    token::token                                    _token; // the '{' token
     std::vector<std::shared_ptr<statement>>    _statements;
 };
 
 class if_expression : public expression {
 public:
     if_expression() noexcept = default;
-    if_expression(token::token token) noexcept : _token(token) {}
+    if_expression(token::span span) noexcept { _span = span; }
     
     std::shared_ptr<const expression> condition() const noexcept { return _condition; }
     std::shared_ptr<const block_statement> consequence() const noexcept { return _consequence; }
@@ -275,34 +353,98 @@ public:
         _alternative = std::shared_ptr<block_statement>(alternative);
     }
 
-    const std::string_view token_literal() const noexcept override { return _token.token_literal(); }
-    const std::string to_string() const noexcept override {
-        std::string buf;
-        buf += "if";
-        buf += _condition->to_string();
-        buf += " ";
-        buf += _consequence->to_string();
+    const std::string token_literal() const noexcept override { return "if"; }
+    void visit_children(child_visitor& v) noexcept override {
+        v.visit(_condition);
+        v.visit(_consequence);
+        if(_alternative != nullptr) { v.visit(_alternative); }
+    }
+    void write(writer& w) const noexcept override {
+        w << "if";
+        _condition->write(w);
+        w << " ";
+        _consequence->write(w);
         if(_alternative != nullptr) {
-            buf += "else ";
-            buf += _alternative->to_string();
+            w << (w.pretty() ? " else " : "else ");
+            _alternative->write(w);
         }
-        return buf;
     }
 
 protected:
-    token::token                            _token; // the 'if' token
     std::shared_ptr<expression>        _condition;
     std::shared_ptr<block_statement>   _consequence;
     std::shared_ptr<block_statement>   _alternative;
 };
 
+/**
+ * while (condition) { body }, runs in the enclosing scope.
+ */
+class while_statement : public statement {
+public:
+    while_statement(token::span span) noexcept { _span = span; }
+
+    std::shared_ptr<const expression> condition() const noexcept { return _condition; }
+    std::shared_ptr<const block_statement> body() const noexcept { return _body; }
+
+    void set_condition(expression* expr) noexcept { _condition = std::shared_ptr<expression>(expr); }
+    void set_body(block_statement* block) noexcept { _body = std::shared_ptr<block_statement>(block); }
+
+    const std::string token_literal() const noexcept override { return "while"; }
+    void visit_children(child_visitor& v) noexcept override {
+        v.visit(_condition);
+        v.visit(_body);
+    }
+    void write(writer& w) const noexcept override {
+        w << (w.pretty() ? "while " : "while");
+        _condition->write(w);
+        w << " ";
+        _body->write(w);
+    }
+
+protected:
+    std::shared_ptr<expression>        _condition;
+    std::shared_ptr<block_statement>   _body;
+};
+
+/**
+ * for (ident in iterable) { body }, binds ident in the enclosing scope.
+ */
+class for_statement : public statement {
+public:
+    for_statement(token::span span) noexcept { _span = span; }
+
+    const identifier& ident() const noexcept { return _ident; }
+    std::shared_ptr<const expression> iterable() const noexcept { return _iterable; }
+    std::shared_ptr<const block_statement> body() const noexcept { return _body; }
+
+    void move_ident(identifier&& ident) noexcept { _ident = std::move(ident); }
+    void set_iterable(expression* expr) noexcept { _iterable = std::shared_ptr<expression>(expr); }
+    void set_body(block_statement* block) noexcept { _body = std::shared_ptr<block_statement>(block); }
+
+    const std::string token_literal() const noexcept override { return "for"; }
+    void visit_children(child_visitor& v) noexcept override {
+        v.visit(_iterable);
+        v.visit(_body);
+    }
+    void write(writer& w) const noexcept override {
+        w << (w.pretty() ? "for (" : "for(") << _ident.value() << " in ";
+        _iterable->write(w);
+        w << ") ";
+        _body->write(w);
+    }
+
+protected:
+    identifier                         _ident;
+    std::shared_ptr<expression>        _iterable;
+    std::shared_ptr<block_statement>   _body;
+};
+
 class function_literal : public expression {
 public:
     function_literal() noexcept = default;
-    function_literal(token::token token) noexcept : _token(token) {};
+    function_literal(token::span span) noexcept { _span = span; };
     
     const std::vector<std::shared_ptr<identifier>>& parameters() const noexcept { return _parameters; }
-    std::vector<std::shared_ptr<identifier>> move_parameters() const noexcept { return std::move(_parameters); }
     std::shared_ptr<const block_statement> body() const noexcept { return _body; }
 
     void set_parameters(std::vector<identifier*> stmt) noexcept {
@@ -313,32 +455,39 @@ public:
     }
     void set_body(block_statement* stmt) noexcept { _body = std::shared_ptr<block_statement>(stmt); }
 
-    const std::string_view token_literal() const noexcept override { return _token.token_literal(); }
-    const std::string to_string() const noexcept override {
-        std::string buf;
-        buf += _token.token_literal();
-        buf += "(";
+    /**
+     * Cached prototype shared by the closures of this literal, null until it is 
+     * built (see prototype.hpp).
+     */
+    const std::shared_ptr<const prototype>& cached_prototype() const noexcept { return _prototype; }
+    void set_prototype(std::shared_ptr<const prototype> proto) const noexcept { _prototype = std::move(proto); }
+
+    const std::string token_literal() const noexcept override { return "fn"; }
+    void visit_children(child_visitor& v) noexcept override { v.visit(_body); }
+    void write(writer& w) const noexcept override {
+        w << "fn(";
         for(int i=0;i<_parameters.size();i++){
-            buf += _parameters[i]->to_string() + ',';
+            w << _parameters[i]->value();
+            if(!w.pretty()) { 
+                w << ","; 
+            } else if(i != _parameters.size() - 1) { 
+                w << ", "; 
+            }
         }
-        buf += ")";
-        buf += _body->to_string();
-        return buf;
+        w << (w.pretty() ? ") " : ")");
+        _body->write(w);
     }
 
 protected:
-    token::token                                        _token;
     std::shared_ptr<block_statement>                    _body;
-    mutable std::vector<std::shared_ptr<identifier>>    _parameters; // marked mutable to be moved to object::function
-                                                                     // so that when the ast::fn_literal object is
-                                                                     // deallocated, the identifiers don't get deallocated
-                                                                     // with it.
+    std::vector<std::shared_ptr<identifier>>            _parameters;
+    mutable std::shared_ptr<const prototype>            _prototype;
 };
 
 class call_expression : public expression {
 public:
     call_expression() noexcept = default;
-    call_expression(token::token token, expression* function) noexcept : _token(token) { set_function(function); }
+    call_expression(token::span span, expression* function) noexcept { _span = span; set_function(function); }
 
     const std::vector<std::shared_ptr<expression>>& arguments() const noexcept { return _arguments; }
 
@@ -352,21 +501,22 @@ public:
     }
     void set_function(expression* stmt) noexcept { _function = std::shared_ptr<expression>(stmt); }
     
-    const std::string_view token_literal() const noexcept override { return _token.token_literal(); }
-    const std::string to_string() const noexcept override {
-        std::string buf;
-        buf += _function->token_literal();
-        buf += "(";
+    const std::string token_literal() const noexcept override { return "("; }
+    void visit_children(child_visitor& v) noexcept override {
+        v.visit(_function);
+        for(auto& arg : _arguments) { v.visit(arg); }
+    }
+    void write(writer& w) const noexcept override {
+        _function->write(w);
+        w << "(";
         for(int i=0;i<_arguments.size();i++){
-            buf += _arguments[i]->to_string();
-            if(i != _arguments.size() - 1) { buf += ", "; }
+            _arguments[i]->write(w);
+            if(i != _arguments.size() - 1) { w << ", "; }
         }
-        buf += ")";
-        return buf;
+        w << ")";
     }
     
 protected:
-    token::token                                _token; // the '(' token
     std::shared_ptr<expression>                 _function; // ident or fn literal
     std::vector<std::shared_ptr<expression>>    _arguments;
 };
@@ -374,21 +524,34 @@ protected:
 class string_literal : public expression {
 public:
     string_literal() noexcept = default;
-    string_literal(token::token token, std::string_view value) noexcept : _token(token), _value(value) {}
+    string_literal(token::span span, std::string_view value) noexcept : _value(value) { _span = span; }
 
     const std::string& value() const noexcept { return _value; }
 
-    const std::string_view token_literal() const noexcept override { return _token.token_literal(); }
-    const std::string to_string() const noexcept override { return _value; }
+    /**
+     * Interned runtime string this literal evaluates to, null until the 
+     * evaluator materialises it on first evaluation.
+     */
+    object::string* constant() const noexcept { return _constant; }
+    void set_constant(object::string* constant) const noexcept { _constant = constant; }
+
+    const std::string token_literal() const noexcept override { return _value; }
+    void write(writer& w) const noexcept override { 
+        if(w.pretty()) { 
+            w << "\"" << _value << "\""; 
+        } else {
+            w << _value;
+        }
+    }
 
 protected:
-    token::token    _token;
-    std::string     _value;
+    std::string                 _value;
+    mutable object::string*     _constant = nullptr;
 };
 
 class array_literal : public expression {
 public:
-    array_literal(token::token token) noexcept : _token(token) {}
+    array_literal(token::span span) noexcept { _span = span; }
 
     const std::vector<std::shared_ptr<expression>>& elements() const noexcept { return _elements; }
 
@@ -399,27 +562,62 @@ public:
         }
     }
 
-    const std::string_view token_literal() const noexcept override { return _token.token_literal(); }
-    const std::string to_string() const noexcept override {
-        std::string buf;
-        buf += "[";
+    const std::string token_literal() const noexcept override { return "["; }
+    void visit_children(child_visitor& v) noexcept override { for(auto& element : _elements) { v.visit(element); } }
+    void write(writer& w) const noexcept override {
+        w << "[";
         for(int i=0;i<_elements.size();i++){
-            buf += _elements[i]->to_string();
-            if(i != _elements.size() - 1) { buf += ", "; }
+            _elements[i]->write(w);
+            if(i != _elements.size() - 1) { w << ", "; }
         }
-        buf += "]";
-        return buf;
+        w << "]";
     }
 
 protected:
-    token::token                                _token; // the '[ token
     std::vector<std::shared_ptr<expression>>    _elements;
 
 }; 
 
+/**
+ * {key: value, ...}, pairs are kept in source order.
+ */
+class hash_literal : public expression {
+public:
+    using pair_t = std::pair<std::shared_ptr<expression>, std::shared_ptr<expression>>;
+
+    hash_literal(token::span span) noexcept { _span = span; }
+
+    const std::vector<pair_t>& pairs() const noexcept { return _pairs; }
+
+    void add_pair(expression* key, expression* value) noexcept { 
+        _pairs.emplace_back(std::shared_ptr<expression>(key), std::shared_ptr<expression>(value)); 
+    }
+
+    const std::string token_literal() const noexcept override { return "{"; }
+    void visit_children(child_visitor& v) noexcept override { 
+        for(auto& [key, value] : _pairs) { 
+            v.visit(key); 
+            v.visit(value); 
+        } 
+    }
+    void write(writer& w) const noexcept override {
+        w << "{";
+        for(std::size_t i = 0; i < _pairs.size(); i++) {
+            _pairs[i].first->write(w);
+            w << ": ";
+            _pairs[i].second->write(w);
+            if(i != _pairs.size() - 1) { w << ", "; }
+        }
+        w << "}";
+    }
+
+protected:
+    std::vector<pair_t>     _pairs;
+};
+
 class index_expression : public expression {
 public:
-    index_expression(token::token token, expression* left) noexcept : _token(token) { set_left(left); }
+    index_expression(token::span span, expression* left) noexcept { _span = span; set_left(left); }
 
     std::shared_ptr<const expression> left() const noexcept { return _left; }
     std::shared_ptr<const expression> index() const noexcept { return _index; }
@@ -427,23 +625,96 @@ public:
     void set_left(expression* left) noexcept { _left = std::shared_ptr<expression>(left); }
     void set_index(expression* index) noexcept { _index = std::shared_ptr<expression>(index); }
 
-    const std::string_view token_literal() const noexcept override { return _token.token_literal(); }
-    const std::string to_string() const noexcept override {
-        std::string buf;
-        buf += "(";
-        buf += _left->to_string();
-        buf += "[";
-        buf += _index->to_string();
-        buf += "])";
-        return buf;
+    const std::string token_literal() const noexcept override { return "["; }
+    void visit_children(child_visitor& v) noexcept override {
+        v.visit(_left);
+        v.visit(_index);
+    }
+    void write(writer& w) const noexcept override {
+        w << "(";
+        _left->write(w);
+        w << "[";
+        _index->write(w);
+        w << "])";
     }
 
 protected: 
-    token::token                        _token; // the '[ token
     std::shared_ptr<expression>         _left;
     std::shared_ptr<expression>         _index;
 };
 
+/**
+ * left[begin:end], a missing bound is null and means the start or the end.
+ */
+class slice_expression : public expression {
+public:
+    slice_expression(token::span span, expression* left, expression* begin) noexcept 
+        : _left(left), _begin(begin) { _span = span; }
+
+    std::shared_ptr<const expression> left() const noexcept { return _left; }
+    std::shared_ptr<const expression> begin() const noexcept { return _begin; }
+    std::shared_ptr<const expression> end() const noexcept { return _end; }
+
+    void set_end(expression* end) noexcept { _end = std::shared_ptr<expression>(end); }
+
+    const std::string token_literal() const noexcept override { return "["; }
+    void visit_children(child_visitor& v) noexcept override {
+        v.visit(_left);
+        v.visit(_begin);
+        v.visit(_end);
+    }
+    void write(writer& w) const noexcept override {
+        w << "(";
+        _left->write(w);
+        w << "[";
+        if(_begin != nullptr) {
+            _begin->write(w);
+        }
+        w << ":";
+        if(_end != nullptr) {
+            _end->write(w);
+        }
+        w << "])";
+    }
+
+protected:
+    std::shared_ptr<expression>         _left;
+    std::shared_ptr<expression>         _begin;
+    std::shared_ptr<expression>         _end;
+};
+
+/**
+ * target = value, where target is an identifier bound by an enclosing let or an
+ * index expression into an array or hash.
+ */
+class assign_expression : public expression {
+public:
+    assign_expression(token::span span, expression* target) noexcept { _span = span; set_target(target); }
+
+    std::shared_ptr<const expression> target() const noexcept { return _target; }
+    std::shared_ptr<const expression> value() const noexcept { return _value; }
+
+    void set_target(expression* target) noexcept { _target = std::shared_ptr<expression>(target); }
+    void set_value(expression* value) noexcept { _value = std::shared_ptr<expression>(value); }
+
+    const std::string token_literal() const noexcept override { return "="; }
+    void visit_children(child_visitor& v) noexcept override {
+        v.visit(_target);
+        v.visit(_value);
+    }
+    void write(writer& w) const noexcept override {
+        w << "(";
+        _target->write(w);
+        w << " = ";
+        _value->write(w);
+        w << ")";
+    }
+
+protected:
+    std::shared_ptr<expression>         _target;
+    std::shared_ptr<expression>         _value;
+};
+
 } // namespace ast
 
 
@@ -1,23 +1,875 @@
 #pragma once
 
+#include "int64_kernels.hpp"
 #include "object.hpp"
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 namespace evaluator {
 
-inline object::object* len_builtin_fn(std::vector<object::object*> args) noexcept {
+inline object::null* NULL_O = new object::null;
+inline object::boolean* TRUE_O = new object::boolean(true);
+inline object::boolean* FALSE_O = new object::boolean(false);
+
+static bool is_truthy(object::object* o) noexcept {
+    return o != NULL_O && o != FALSE_O;
+}
+
+/**
+ * A new array of elements, holding them unboxed if they are all integers.
+ */
+static object::object* new_array(std::vector<object::object*> elements) noexcept {
+    if(!elements.empty() && std::all_of(elements.begin(), elements.end(), [](object::object* e) { return e->type() == object::INTEGER_OBJ; })) {
+        std::vector<std::int64_t> values(elements.size());
+        std::transform(elements.begin(), elements.end(), values.begin(), [](object::object* e) { return object::as<object::integer>(e)->value(); });
+        return object::array::of_int64(std::move(values));
+    }
+    return new object::array(std::move(elements));
+}
+
+/**
+ * Calls the function argument of a higher-order builtin, once per element. A
+ * Monkey function whose frame cannot escape and whose body binds nothing but
+ * its parameters is called in a single frame, acquired once, and each call
+ * only stores the arguments into the parameter slots. Other functions and
+ * builtins go through apply_function(). Defined in evaluator.hpp.
+ */
+class callback {
+public:
+    explicit callback(object::object* fn) noexcept;
+    ~callback() noexcept;
+    callback(const callback&) = delete;
+    callback& operator=(const callback&) = delete;
+
+    static bool callable(const object::object* fn) noexcept { 
+        return fn->type() == object::FUNCTION_OBJ || fn->type() == object::BUILTIN_OBJ; 
+    }
+
+    /**
+     * fn(args), an error if the call failed.
+     */
+    object::object* operator()(object::args_t args) noexcept;
+
+    /**
+     * Whether calls skip frame setup.
+     */
+    bool fast() const noexcept { return _frame != nullptr; }
+
+private:
+    object::object*                 _fn;
+    object::function*               _function = nullptr;
+    object::scope*                  _frame = nullptr;
+    std::vector<object::object**>   _params;
+};
+
+/**
+ * A Monkey function of one parameter whose body is a single expression built
+ * from the parameter, integer literals, names bound to integers, prefix - and
+ * the operators + - * / < > == !=, compiled to a postfix program that runs on
+ * unboxed integers and allocates nothing. Other names are read when the
+ * callback is made, which is only done where no Monkey code runs while it is
+ * in use. ok() is false for any other function, which then has to go through
+ * a callback.
+ */
+class int64_callback {
+public:
+    explicit int64_callback(object::object* fn) noexcept {
+        object::function* function = object::as<object::function>(fn);
+        if (function == nullptr || function->proto().arity != 1 || function->body()->statements().size() != 1) {
+            return;
+        }
+        const ast::statement* only = function->body()->statements()[0].get();
+        std::shared_ptr<const ast::expression> body;
+        if (auto es = dynamic_cast<const ast::expression_statement*>(only)) {
+            body = es->expr();
+        } else if (auto rs = dynamic_cast<const ast::return_statement*>(only)) {
+            body = rs->return_value();
+        }
+        object::scope names(function->get_scope(), function->captured());
+        std::optional<kind> res = body != nullptr ? compile(*body, function->parameters()[0]->value(), names) : std::nullopt;
+        _ok = res.has_value();
+        _boolean = res == kind::boolean;
+        _stack.resize(_code.size());
+    }
+
+    bool ok() const noexcept { return _ok; }
+
+    /**
+     * Whether calls yield booleans, as 1 and 0, rather than integers.
+     */
+    bool boolean() const noexcept { return _boolean; }
+
+    /**
+     * fn(x), false on a division by zero.
+     */
+    bool operator()(std::int64_t x, std::int64_t& out) noexcept {
+        std::size_t top = 0;
+        for (const instruction& in : _code) {
+            switch (in.code) {
+            case opcode::param:     _stack[top++] = x; break;
+            case opcode::constant:  _stack[top++] = in.value; break;
+            case opcode::negate:    _stack[top - 1] = kernels::scalar::apply(kernels::op::sub, 0, _stack[top - 1]); break;
+            case opcode::binary:
+                if (in.op == kernels::op::div && _stack[top - 1] == 0) {
+                    return false;
+                }
+                --top;
+                _stack[top - 1] = kernels::scalar::apply(in.op, _stack[top - 1], _stack[top]);
+                break;
+            }
+        }
+        out = _stack[0];
+        return true;
+    }
+
+private:
+    enum class kind : std::uint8_t { integer, boolean };
+    enum class opcode : std::uint8_t { param, constant, negate, binary };
+
+    struct instruction {
+        opcode          code;
+        kernels::op     op = kernels::op::add;
+        std::int64_t    value = 0;
+    };
+
+    std::optional<kind> compile(const ast::expression& e, std::string_view param, const object::scope& names) noexcept {
+        if (auto n = dynamic_cast<const ast::int_literal*>(&e)) {
+            _code.push_back({opcode::constant, kernels::op::add, n->value()});
+            return kind::integer;
+        }
+        if (auto n = dynamic_cast<const ast::identifier*>(&e)) {
+            if (n->value() == param) {
+                _code.push_back({opcode::param});
+                return kind::integer;
+            }
+            auto bound = object::as<object::integer>(names.get(std::string(n->value())));
+            if (bound == nullptr) {
+                return std::nullopt;
+            }
+            _code.push_back({opcode::constant, kernels::op::add, bound->value()});
+            return kind::integer;
+        }
+        if (auto n = dynamic_cast<const ast::prefix_expression*>(&e)) {
+            if (n->op() != "-" || compile(*n->expr(), param, names) != kind::integer) {
+                return std::nullopt;
+            }
+            _code.push_back({opcode::negate});
+            return kind::integer;
+        }
+        if (auto n = dynamic_cast<const ast::infix_expression*>(&e)) {
+            static const std::pair<std::string_view, kernels::op> ops[] = {
+                {"+", kernels::op::add}, {"-", kernels::op::sub}, {"*", kernels::op::mul}, {"/", kernels::op::div},
+                {"<", kernels::op::lt}, {">", kernels::op::gt}, {"==", kernels::op::eq}, {"!=", kernels::op::ne},
+            };
+            auto it = std::find_if(std::begin(ops), std::end(ops), [&](const auto& o) { return o.first == n->op(); });
+            if (it == std::end(ops) || compile(*n->l_expr(), param, names) != kind::integer 
+                    || compile(*n->r_expr(), param, names) != kind::integer) {
+                return std::nullopt;
+            }
+            _code.push_back({opcode::binary, it->second});
+            return it->second < kernels::op::lt ? kind::integer : kind::boolean;
+        }
+        return std::nullopt;
+    }
+
+    std::vector<instruction>    _code;
+    std::vector<std::int64_t>   _stack;
+    bool                        _ok = false;
+    bool                        _boolean = false;
+};
+
+static bool iterable(const object::object* obj) noexcept {
+    return obj->type() == object::ARRAY_OBJ || obj->type() == object::RANGE_OBJ || obj->type() == object::SEQUENCE_OBJ;
+}
+
+/**
+ * Feeds the elements of an array, a range or a sequence to sink, running the
+ * stages of a sequence on each element on the way. sink returns nullptr to be
+ * fed the next element, anything else stops the walk and is returned. The
+ * walk also stops as soon as a take stage has let its last element through,
+ * or at the first error of a stage, which is returned. Returns nullptr when 
+ * the elements run out.
+ */
+template <typename Sink>
+inline object::object* drain(object::object* source, Sink&& sink) noexcept {
+    object::sequence* seq = object::as<object::sequence>(source);
+    object::cursor elements(seq != nullptr ? seq->source() : source);
+    std::span<const object::sequence::stage> stages;
+    if (seq != nullptr) {
+        stages = seq->stages();
+    }
+    std::vector<std::unique_ptr<callback>> fns(stages.size());
+    std::vector<std::int64_t> remaining(stages.size());
+    for (std::size_t k = 0; k < stages.size(); k++) {
+        if (stages[k].kind == object::sequence::stage_kind::take) {
+            if (stages[k].count <= 0) {
+                return nullptr;
+            }
+            remaining[k] = stages[k].count;
+        } else {
+            fns[k] = std::make_unique<callback>(stages[k].fn);
+        }
+    }
+
+    object::object* x;
+    while (elements.next(x)) {
+        bool keep = true;
+        bool last = false;
+        for (std::size_t k = 0; k < stages.size() && keep; k++) {
+            switch (stages[k].kind) {
+            case object::sequence::stage_kind::map:
+                x = (*fns[k])(std::span<object::object* const>(&x, 1));
+                if (x->type() == object::ERROR_OBJ) {
+                    return x;
+                }
+                break;
+            case object::sequence::stage_kind::filter: {
+                object::object* res = (*fns[k])(std::span<object::object* const>(&x, 1));
+                if (res->type() == object::ERROR_OBJ) {
+                    return res;
+                }
+                keep = is_truthy(res);
+                break;
+            }
+            case object::sequence::stage_kind::take:
+                last = last || --remaining[k] == 0;
+                break;
+            }
+        }
+        if (keep) {
+            if (object::object* stop = sink(x)) {
+                return stop;
+            }
+        }
+        if (last) {
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * drain() on unboxed integers, for a range or an integer array whose
+ * sequence stages all compile to an int64_callback: maps that yield integers
+ * and filters that yield booleans. Elements are never boxed, so the walk
+ * allocates nothing however many elements it produces. sink takes an 
+ * std::int64_t. Returns false, having run nothing, for other sources or
+ * stages, which are left to drain(). Otherwise res is what drain() would 
+ * return, with a division by zero as its error.
+ */
+template <typename Sink>
+inline bool drain_int64(object::object* source, Sink&& sink, object::object*& res) noexcept {
+    object::sequence* seq = object::as<object::sequence>(source);
+    object::object* from = seq != nullptr ? seq->source() : source;
+    const object::range* r = object::as<object::range>(from);
+    const object::array* arr = object::as<object::array>(from);
+    if (r == nullptr && (arr == nullptr || !arr->is_int64())) {
+        return false;
+    }
+    std::span<const object::sequence::stage> stages;
+    if (seq != nullptr) {
+        stages = seq->stages();
+    }
+    std::vector<std::unique_ptr<int64_callback>> fns(stages.size());
+    std::vector<std::int64_t> remaining(stages.size());
+    for (std::size_t k = 0; k < stages.size(); k++) {
+        if (stages[k].kind == object::sequence::stage_kind::take) {
+            remaining[k] = stages[k].count;
+            continue;
+        }
+        fns[k] = std::make_unique<int64_callback>(stages[k].fn);
+        bool filter = stages[k].kind == object::sequence::stage_kind::filter;
+        if (!fns[k]->ok() || fns[k]->boolean() != filter) {
+            return false;
+        }
+    }
+    res = nullptr;
+    for (std::size_t k = 0; k < stages.size(); k++) {
+        if (stages[k].kind == object::sequence::stage_kind::take && stages[k].count <= 0) {
+            return true;
+        }
+    }
+
+    std::span<const std::int64_t> values = arr != nullptr ? arr->int64() : std::span<const std::int64_t>();
+    std::size_t size = r != nullptr ? r->size() : values.size();
+    for (std::size_t i = 0; i < size; i++) {
+        std::int64_t x = r != nullptr ? r->at(i) : values[i];
+        bool keep = true;
+        bool last = false;
+        for (std::size_t k = 0; k < stages.size() && keep; k++) {
+            if (stages[k].kind == object::sequence::stage_kind::take) {
+                last = last || --remaining[k] == 0;
+                continue;
+            }
+            std::int64_t y;
+            if (!(*fns[k])(x, y)) {
+                res = object::error::of(object::DIVISION_BY_ZERO_ERR, object::INTEGER_OBJ);
+                return true;
+            }
+            if (stages[k].kind == object::sequence::stage_kind::map) {
+                x = y;
+            } else {
+                keep = y != 0;
+            }
+        }
+        if (keep) {
+            if (object::object* stop = sink(x)) {
+                res = stop;
+                return true;
+            }
+        }
+        if (last) {
+            return true;
+        }
+    }
+    return true;
+}
+
+/**
+ * Length of a string in characters, see object::string::length(), of an
+ * array, a hash or a range.
+ */
+inline object::object* len_builtin_fn(object::args_t args) noexcept {
     if (args.size() != 1) {
-        return new object::error("wrong number of arguments. got=" +std::to_string(args.size()) + ", want=1" );
+        return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), 1);
+    }
+    if (auto str = object::as<object::string>(args[0])) {
+        return new object::integer(str->length());
+    }
+    if (auto arr = object::as<object::array>(args[0])) {
+        return new object::integer(arr->size());
+    }
+    if (auto hash = object::as<object::hash_map>(args[0])) {
+        return new object::integer(hash->size());
+    }
+    if (auto r = object::as<object::range>(args[0])) {
+        return new object::integer(r->size());
+    }
+    return object::error::argument("len", args[0]->type());
+}
+
+/**
+ * All elements of an array but the first, a slice that shares its storage.
+ */
+inline object::object* rest_builtin_fn(object::args_t args) noexcept {
+    if (args.size() != 1) {
+        return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), 1);
+    }
+    if (auto arr = object::as<object::array>(args[0])) {
+        return arr->slice(1, arr->size());
+    }
+    return object::error::argument("rest", args[0]->type());
+}
+
+/**
+ * substr(s, pos) or substr(s, pos, count), in characters, see object::string::slice().
+ */
+inline object::object* substr_builtin_fn(object::args_t args) noexcept {
+    if (args.size() != 2 && args.size() != 3) {
+        return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), 3);
+    }
+    auto str = object::as<object::string>(args[0]);
+    if (str == nullptr) {
+        return object::error::argument("substr", args[0]->type());
+    }
+    std::int64_t bounds[2] = {0, std::numeric_limits<std::int64_t>::max()};
+    for (std::size_t i = 1; i < args.size(); i++) {
+        auto n = object::as<object::integer>(args[i]);
+        if (n == nullptr) {
+            return object::error::argument("substr", args[i]->type());
+        }
+        bounds[i - 1] = n->value();
+    }
+    std::int64_t pos = std::max<std::int64_t>(bounds[0], 0);
+    std::int64_t count = std::max<std::int64_t>(bounds[1], 0);
+    std::int64_t end = count > std::numeric_limits<std::int64_t>::max() - pos ? std::numeric_limits<std::int64_t>::max() : pos + count;
+    return str->slice(pos, end);
+}
+
+/**
+ * push(a, x), a new array with x appended, sharing the structure of a, see object::array::push().
+ */
+inline object::object* push_builtin_fn(object::args_t args) noexcept {
+    if (args.size() != 2) {
+        return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), 2);
+    }
+    if (auto arr = object::as<object::array>(args[0])) {
+        return arr->push(args[1]);
+    }
+    return object::error::argument("push", args[0]->type());
+}
+
+/**
+ * set(a, i, x), a new array with element i replaced by x, a is unchanged.
+ */
+inline object::object* set_builtin_fn(object::args_t args) noexcept {
+    if (args.size() != 3) {
+        return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), 3);
+    }
+    auto arr = object::as<object::array>(args[0]);
+    if (arr == nullptr) {
+        return object::error::argument("set", args[0]->type());
+    }
+    auto idx = object::as<object::integer>(args[1]);
+    if (idx == nullptr) {
+        return object::error::argument("set", args[1]->type());
+    }
+    if (idx->value() < 0 || static_cast<std::size_t>(idx->value()) >= arr->size()) {
+        return new object::error(object::INDEX_RANGE_ERR, idx->value());
+    }
+    return arr->updated(idx->value(), args[2]);
+}
+
+/**
+ * concat(a, b), a new array with the elements of b appended to those of a.
+ */
+inline object::object* concat_builtin_fn(object::args_t args) noexcept {
+    if (args.size() != 2) {
+        return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), 2);
+    }
+    auto left = object::as<object::array>(args[0]);
+    if (left == nullptr) {
+        return object::error::argument("concat", args[0]->type());
+    }
+    auto right = object::as<object::array>(args[1]);
+    if (right == nullptr) {
+        return object::error::argument("concat", args[1]->type());
+    }
+    return left->concat(right);
+}
+
+/**
+ * Keys of a hash in insertion order.
+ */
+inline object::object* keys_builtin_fn(object::args_t args) noexcept {
+    if (args.size() != 1) {
+        return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), 1);
+    }
+    auto hash = object::as<object::hash_map>(args[0]);
+    if (hash == nullptr) {
+        return object::error::argument("keys", args[0]->type());
+    }
+    std::vector<object::object*> res;
+    res.reserve(hash->size());
+    hash->for_each([&](object::object* key, object::object*) { res.push_back(key); });
+    return new object::array(std::move(res));
+}
+
+/**
+ * Values of a hash in the insertion order of their keys.
+ */
+inline object::object* values_builtin_fn(object::args_t args) noexcept {
+    if (args.size() != 1) {
+        return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), 1);
+    }
+    auto hash = object::as<object::hash_map>(args[0]);
+    if (hash == nullptr) {
+        return object::error::argument("values", args[0]->type());
+    }
+    std::vector<object::object*> res;
+    res.reserve(hash->size());
+    hash->for_each([&](object::object*, object::object* value) { res.push_back(value); });
+    return new object::array(std::move(res));
+}
+
+/**
+ * insert(h, k, v), binds k to v in h like h[k] = v and returns h.
+ */
+inline object::object* insert_builtin_fn(object::args_t args) noexcept {
+    if (args.size() != 3) {
+        return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), 3);
+    }
+    auto hash = object::as<object::hash_map>(args[0]);
+    if (hash == nullptr) {
+        return object::error::argument("insert", args[0]->type());
+    }
+    if (!object::hash_map::hashable(args[1])) {
+        return object::error::of(object::HASH_KEY_ERR, args[1]->type());
+    }
+    hash->set(args[1], args[2]);
+    return hash;
+}
+
+/**
+ * The elements of arr as integers, the unboxed elements of an integer array or
+ * a copy in buf. Returns the type of the first element that is not an integer,
+ * INTEGER_OBJ if there is none.
+ */
+inline object::object_t int64_elements(const object::array* arr, std::vector<std::int64_t>& buf, 
+        std::span<const std::int64_t>& out) noexcept {
+    if (arr->is_int64()) {
+        out = arr->int64();
+        return object::INTEGER_OBJ;
+    }
+    buf.resize(arr->size());
+    for (std::size_t i = 0; i < arr->size(); i++) {
+        object::object* e = arr->at(i);
+        if (e->type() != object::INTEGER_OBJ) {
+            return e->type();
+        }
+        buf[i] = object::as<object::integer>(e)->value();
+    }
+    out = buf;
+    return object::INTEGER_OBJ;
+}
+
+/**
+ * sum(a), min(a) and max(a) of an array, a range or a sequence of integers, 
+ * min and max of nothing are null. Ranges and sequences are reduced in chunks
+ * as their elements are produced. Pipelines that drain_int64() can run take
+ * constant space, others box each element on the way.
+ */
+template <std::int64_t (*Kernel)(std::span<const std::int64_t>) noexcept, bool Empty>
+inline object::object* int64_reduction_fn(std::string_view name, object::args_t args) noexcept {
+    if (args.size() != 1) {
+        return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), 1);
+    }
+    if (!iterable(args[0])) {
+        return object::error::argument(name, args[0]->type());
+    }
+    if (auto arr = object::as<object::array>(args[0])) {
+        std::vector<std::int64_t> buf;
+        std::span<const std::int64_t> values;
+        if (object::object_t bad = int64_elements(arr, buf, values); bad != object::INTEGER_OBJ) {
+            return object::error::argument(name, bad);
+        }
+        if (values.empty() && !Empty) {
+            return NULL_O;
+        }
+        return new object::integer(Kernel(values));
+    }
+
+    std::int64_t chunk[256];
+    std::size_t n = 0;
+    std::int64_t acc = 0;
+    bool any = false;
+    auto flush = [&] {
+        std::int64_t partial[2] = {acc, Kernel(std::span<const std::int64_t>(chunk, n))};
+        acc = any ? Kernel(std::span<const std::int64_t>(partial)) : partial[1];
+        any = true;
+        n = 0;
+    };
+    auto push = [&](std::int64_t x) -> object::object* {
+        chunk[n++] = x;
+        if (n == std::size(chunk)) {
+            flush();
+        }
+        return nullptr;
+    };
+    object::object* err;
+    if (!drain_int64(args[0], push, err)) {
+        err = drain(args[0], [&](object::object* x) -> object::object* {
+            auto i = object::as<object::integer>(x);
+            return i != nullptr ? push(i->value()) : object::error::argument(name, x->type());
+        });
+    }
+    if (err != nullptr) {
+        return err;
+    }
+    if (n > 0) {
+        flush();
+    }
+    if (!any && !Empty) {
+        return NULL_O;
+    }
+    return new object::integer(acc);
+}
+
+inline object::object* sum_builtin_fn(object::args_t args) noexcept { return int64_reduction_fn<kernels::sum, true>("sum", args); }
+inline object::object* min_builtin_fn(object::args_t args) noexcept { return int64_reduction_fn<kernels::min, false>("min", args); }
+inline object::object* max_builtin_fn(object::args_t args) noexcept { return int64_reduction_fn<kernels::max, false>("max", args); }
+
+/**
+ * dot(a, b), the sum of a[i] * b[i] over two arrays of integers of the same length.
+ */
+inline object::object* dot_builtin_fn(object::args_t args) noexcept {
+    if (args.size() != 2) {
+        return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), 2);
+    }
+    std::vector<std::int64_t> bufs[2];
+    std::span<const std::int64_t> values[2];
+    for (std::size_t i = 0; i < 2; i++) {
+        auto arr = object::as<object::array>(args[i]);
+        if (arr == nullptr) {
+            return object::error::argument("dot", args[i]->type());
+        }
+        if (object::object_t bad = int64_elements(arr, bufs[i], values[i]); bad != object::INTEGER_OBJ) {
+            return object::error::argument("dot", bad);
+        }
+    }
+    if (values[0].size() != values[1].size()) {
+        return new object::error(object::LENGTH_MISMATCH_ERR, values[0].size(), values[1].size());
+    }
+    return new object::integer(kernels::dot(values[0], values[1]));
+}
+
+/**
+ * count(a, x), the number of elements of a equal to x. Integers and strings are
+ * compared by value, anything else by identity.
+ */
+inline object::object* count_builtin_fn(object::args_t args) noexcept {
+    if (args.size() != 2) {
+        return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), 2);
+    }
+    auto arr = object::as<object::array>(args[0]);
+    if (arr == nullptr) {
+        return object::error::argument("count", args[0]->type());
+    }
+    auto n = object::as<object::integer>(args[1]);
+    if (arr->is_int64()) {
+        return new object::integer(n != nullptr ? kernels::count(arr->int64(), n->value()) : 0);
+    }
+    auto str = object::as<object::string>(args[1]);
+    std::int64_t res = 0;
+    for (std::size_t i = 0; i < arr->size(); i++) {
+        object::object* e = arr->at(i);
+        if (auto m = object::as<object::integer>(e)) {
+            res += n != nullptr && m->value() == n->value();
+        } else if (auto s = object::as<object::string>(e)) {
+            res += str != nullptr && s->equals(str);
+        } else {
+            res += e == args[1];
+        }
+    }
+    return new object::integer(res);
+}
+
+/**
+ * Checks the arguments of f(s, fn, ...), s must be an array, a range or a 
+ * sequence and fn a function. Returns the error, if any.
+ */
+inline object::object* higher_order_args(std::string_view name, object::args_t args, std::size_t count) noexcept {
+    if (args.size() != count) {
+        return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), count);
+    }
+    if (!iterable(args[0])) {
+        return object::error::argument(name, args[0]->type());
+    }
+    if (!callback::callable(args[1])) {
+        return object::error::argument(name, args[1]->type());
+    }
+    return nullptr;
+}
+
+/**
+ * Sequence of the elements of a range or a sequence, nullptr for an array.
+ */
+inline object::sequence* lazy(object::object* source) noexcept {
+    if (auto seq = object::as<object::sequence>(source)) {
+        return seq;
+    }
+    return source->type() == object::RANGE_OBJ ? new object::sequence(source) : nullptr;
+}
+
+/**
+ * All elements of s as an array, or the error of a stage. Pipelines that 
+ * drain_int64() can run fill an unboxed array directly.
+ */
+inline object::object* collect(object::object* s) noexcept {
+    std::vector<std::int64_t> values;
+    object::object* stop;
+    if (drain_int64(s, [&](std::int64_t x) -> object::object* { values.push_back(x); return nullptr; }, stop)) {
+        if (stop != nullptr) {
+            return stop;
+        }
+        return values.empty() ? new_array({}) : object::array::of_int64(std::move(values));
+    }
+    std::vector<object::object*> res;
+    object::object* err = drain(s, [&](object::object* x) -> object::object* { 
+        res.push_back(x); 
+        return nullptr; 
+    });
+    return err != nullptr ? err : new_array(std::move(res));
+}
+
+/**
+ * map(s, f), f(x) for every element x of s. An array is mapped right away, a
+ * range or a sequence makes a sequence that maps when it is consumed.
+ */
+inline object::object* map_builtin_fn(object::args_t args) noexcept {
+    if (object::object* err = higher_order_args("map", args, 2)) {
+        return err;
+    }
+    if (object::sequence* seq = lazy(args[0])) {
+        return seq->then({object::sequence::stage_kind::map, args[1]});
+    }
+    object::sequence mapped(args[0], {{object::sequence::stage_kind::map, args[1]}});
+    return collect(&mapped);
+}
+
+/**
+ * filter(s, f), the elements x of s for which f(x) is truthy, right away for
+ * an array and lazily for a range or a sequence.
+ */
+inline object::object* filter_builtin_fn(object::args_t args) noexcept {
+    if (object::object* err = higher_order_args("filter", args, 2)) {
+        return err;
+    }
+    if (object::sequence* seq = lazy(args[0])) {
+        return seq->then({object::sequence::stage_kind::filter, args[1]});
+    }
+    object::sequence filtered(args[0], {{object::sequence::stage_kind::filter, args[1]}});
+    return collect(&filtered);
+}
+
+/**
+ * take(s, n), the first n elements of s, a slice of an array and a sequence
+ * that stops after n elements otherwise.
+ */
+inline object::object* take_builtin_fn(object::args_t args) noexcept {
+    if (args.size() != 2) {
+        return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), 2);
+    }
+    if (!iterable(args[0])) {
+        return object::error::argument("take", args[0]->type());
+    }
+    auto n = object::as<object::integer>(args[1]);
+    if (n == nullptr) {
+        return object::error::argument("take", args[1]->type());
+    }
+    if (auto arr = object::as<object::array>(args[0])) {
+        return arr->slice(0, n->value());
+    }
+    return lazy(args[0])->then({object::sequence::stage_kind::take, nullptr, n->value()});
+}
+
+/**
+ * range(end), range(start, end) or range(start, end, step), see object::range.
+ */
+inline object::object* range_builtin_fn(object::args_t args) noexcept {
+    if (args.size() < 1 || args.size() > 3) {
+        return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), 3);
+    }
+    std::int64_t bounds[3] = {0, 0, 1};
+    for (std::size_t i = 0; i < args.size(); i++) {
+        auto n = object::as<object::integer>(args[i]);
+        if (n == nullptr) {
+            return object::error::argument("range", args[i]->type());
+        }
+        bounds[args.size() == 1 ? 1 : i] = n->value();
+    }
+    if (bounds[2] == 0) {
+        return object::error::of(object::RANGE_STEP_ERR, object::INTEGER_OBJ);
+    }
+    return new object::range(bounds[0], bounds[1], bounds[2]);
+}
+
+/**
+ * iter(s), a sequence over an array or a range, so that map and filter on it
+ * are lazy and fused as well. A sequence is returned as it is.
+ */
+inline object::object* iter_builtin_fn(object::args_t args) noexcept {
+    if (args.size() != 1) {
+        return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), 1);
+    }
+    if (!iterable(args[0])) {
+        return object::error::argument("iter", args[0]->type());
+    }
+    if (args[0]->type() == object::SEQUENCE_OBJ) {
+        return args[0];
+    }
+    return new object::sequence(args[0]);
+}
+
+/**
+ * collect(s), the elements of an array, a range or a sequence as a new array.
+ */
+inline object::object* collect_builtin_fn(object::args_t args) noexcept {
+    if (args.size() != 1) {
+        return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), 1);
+    }
+    if (!iterable(args[0])) {
+        return object::error::argument("collect", args[0]->type());
+    }
+    return collect(args[0]);
+}
+
+/**
+ * each(s, f), calls f(x) for every element x of s, returns null.
+ */
+inline object::object* each_builtin_fn(object::args_t args) noexcept {
+    if (object::object* err = higher_order_args("each", args, 2)) {
+        return err;
+    }
+    callback fn(args[1]);
+    object::object* err = drain(args[0], [&](object::object* x) -> object::object* {
+        object::object* res = fn(std::span<object::object* const>(&x, 1));
+        return res->type() == object::ERROR_OBJ ? res : nullptr;
+    });
+    return err != nullptr ? err : NULL_O;
+}
+
+/**
+ * find(s, f), the first element x of s for which f(x) is truthy, null if there is none.
+ */
+inline object::object* find_builtin_fn(object::args_t args) noexcept {
+    if (object::object* err = higher_order_args("find", args, 2)) {
+        return err;
+    }
+    callback fn(args[1]);
+    object::object* found = drain(args[0], [&](object::object* x) -> object::object* {
+        object::object* res = fn(std::span<object::object* const>(&x, 1));
+        return res->type() == object::ERROR_OBJ ? res : is_truthy(res) ? x : nullptr;
+    });
+    return found != nullptr ? found : NULL_O;
+}
+
+/**
+ * reduce(s, f, init), folds s from the left with acc = f(acc, x), starting
+ * with init. Without init the fold starts with the first element, and an 
+ * empty s reduces to null.
+ */
+inline object::object* reduce_builtin_fn(object::args_t args) noexcept {
+    if (object::object* err = higher_order_args("reduce", args, args.size() == 2 ? 2 : 3)) {
+        return err;
     }
-    if (auto str = dynamic_cast<object::string*>(args[0])) {
-        return new object::integer(str->value().size());
+    object::object* acc = args.size() == 3 ? args[2] : nullptr;
+    callback fn(args[1]);
+    object::object* err = drain(args[0], [&](object::object* x) -> object::object* {
+        if (acc == nullptr) {
+            acc = x;
+            return nullptr;
+        }
+        object::object* argv[] = {acc, x};
+        acc = fn(argv);
+        return acc->type() == object::ERROR_OBJ ? acc : nullptr;
+    });
+    if (err != nullptr) {
+        return err;
     }
-    return new object::error("argument to len not supported, got " + std::string(args[0]->type()));
+    return acc != nullptr ? acc : NULL_O;
 }
 
 static std::unordered_map<std::string_view, object::builtin*> builtin_fn_map {
-    {"len", new object::builtin(len_builtin_fn)}
+    {"len", new object::builtin(len_builtin_fn)},
+    {"rest", new object::builtin(rest_builtin_fn)},
+    {"substr", new object::builtin(substr_builtin_fn)},
+    {"push", new object::builtin(push_builtin_fn)},
+    {"set", new object::builtin(set_builtin_fn)},
+    {"concat", new object::builtin(concat_builtin_fn)},
+    {"keys", new object::builtin(keys_builtin_fn)},
+    {"values", new object::builtin(values_builtin_fn)},
+    {"insert", new object::builtin(insert_builtin_fn)},
+    {"sum", new object::builtin(sum_builtin_fn)},
+    {"min", new object::builtin(min_builtin_fn)},
+    {"max", new object::builtin(max_builtin_fn)},
+    {"dot", new object::builtin(dot_builtin_fn)},
+    {"count", new object::builtin(count_builtin_fn)},
+    {"map", new object::builtin(map_builtin_fn)},
+    {"filter", new object::builtin(filter_builtin_fn)},
+    {"reduce", new object::builtin(reduce_builtin_fn)},
+    {"each", new object::builtin(each_builtin_fn)},
+    {"find", new object::builtin(find_builtin_fn)},
+    {"take", new object::builtin(take_builtin_fn)},
+    {"range", new object::builtin(range_builtin_fn)},
+    {"iter", new object::builtin(iter_builtin_fn)},
+    {"collect", new object::builtin(collect_builtin_fn)},
 };
 
 static object::object* get_builtin(std::string_view builtin_fn_name) noexcept {
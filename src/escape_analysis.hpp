@@ -0,0 +1,43 @@
+#pragma once
+
+#include "ast.hpp"
+#include <memory>
+
+namespace ast {
+
+/**
+ * Decides whether the call frame of a function can outlive the call. Only a
+ * function created inside the body can hold on to the frame, so a frame escapes
+ * when the body contains a function literal. Any such literal is assumed to be
+ * returned or stored, even if it is only called in place.
+ */
+class escape_analysis : public child_visitor {
+public:
+    static bool frame_escapes(const function_literal& fn) noexcept {
+        escape_analysis a;
+        // the walk only reads, child_visitor hands out mutable references
+        const_cast<function_literal&>(fn).visit_children(a);
+        return a._escapes;
+    }
+
+    void visit(std::shared_ptr<statement>& child) noexcept override { walk(child); }
+    void visit(std::shared_ptr<expression>& child) noexcept override { walk(child); }
+    void visit(std::shared_ptr<block_statement>& child) noexcept override { walk(child); }
+
+private:
+    template <typename T>
+    void walk(std::shared_ptr<T>& n) noexcept {
+        if(_escapes || n == nullptr) {
+            return;
+        }
+        if(dynamic_cast<const function_literal*>(n.get()) != nullptr) {
+            _escapes = true;
+            return;
+        }
+        n->visit_children(*this);
+    }
+
+    bool _escapes = false;
+};
+
+} // namespace ast
@@ -1,17 +1,18 @@
 #pragma once
 
 #include "builtin_fns.hpp"
+#include "prototype.hpp"
 #include "trace.hpp"
 #include "object.hpp"
 #include "ast.hpp"
+#include <algorithm>
+#include <limits>
 #include <memory>
+#include <optional>
+#include <span>
 
 namespace evaluator {
 
-inline object::null* NULL_O = new object::null;
-inline object::boolean* TRUE_O = new object::boolean(true);
-inline object::boolean* FALSE_O = new object::boolean(false);
-
 // forward declaration to avoid compiler complaints
 static object::object* eval(std::shared_ptr<const ast::node> node, object::scope* scope); 
 
@@ -24,16 +25,16 @@ inline static bool is_error(object::object* obj) noexcept {
 
 static object::object* eval_program (const std::vector<std::shared_ptr<ast::statement>>& stmts, object::scope* scope) {
     parser::trace t("eval_statements: " + std::to_string(stmts.size()) + " stmts.");
-    object::object* result;
+    object::object* result = nullptr;
     
     for(const auto& stmt : stmts){
         result = eval(stmt, scope);
 
-        if(auto* rv = dynamic_cast<object::return_value*>(result)) {
-            return rv->value();
-        }
-        if(auto* e = dynamic_cast<object::error*>(result)) {
-            return e;
+        if(result != nullptr && result->abrupt()) {
+            if(auto* rv = object::as<object::return_value>(result)) {
+                return rv->value();
+            }
+            return result;
         }
     }
 
@@ -41,7 +42,7 @@ static object::object* eval_program (const std::vector<std::shared_ptr<ast::stat
 }
 
 static object::object* eval_bang_operator_expression(object::object* right) noexcept {
-    parser::trace t("eval_bang_operator_expr: " + right->inspect());
+    parser::trace t([&] { return "eval_bang_operator_expr: " + right->inspect(); });
     if(right == TRUE_O) {
         return FALSE_O;
     } else if(right == FALSE_O) {
@@ -55,42 +56,45 @@ static object::object* eval_bang_operator_expression(object::object* right) noex
 
 static object::object* eval_minus_prefix_operator_expression(object::object* right) noexcept {
     if(right->type() != object::INTEGER_OBJ) {
-        return new object::error("unknown operator: -" + std::string(right->type()));
+        return object::error::of(object::UNKNOWN_PREFIX_ERR, right->type(), "-", right->type());
     }
-    object::integer* r = dynamic_cast<object::integer*>(right);
+    object::integer* r = object::as<object::integer>(right);
     return new object::integer(-(r->value()));
 }
 
 static object::object* eval_prefix_expression(std::string_view op, object::object* right) {
-    parser::trace t("eval_prefix_expression_method: " + std::string(op) + " " + right->inspect());
+    parser::trace t([&] { return "eval_prefix_expression_method: " + std::string(op) + " " + right->inspect(); });
     if (op == "!") {
         return eval_bang_operator_expression(right);
     } else if (op == "-") {
         return eval_minus_prefix_operator_expression(right);
     } else {
-        return new object::error("unknown operator: "  + std::string(op) + right->type());
+        return object::error::of(object::UNKNOWN_PREFIX_ERR, right->type(), op, right->type());
     }
 }
 
 static object::object* eval_bool_infix_expression(object::boolean* left, std::string_view op, object::boolean* right) noexcept {
-    parser::trace t("eval_infix_bool_expr_method: " + left->inspect() + " " + std::string(op) + " " + right->inspect());
+    parser::trace t([&] { return "eval_infix_bool_expr_method: " + left->inspect() + " " + std::string(op) + " " + right->inspect(); });
     if(op == "!=") {
         return (left->value() != right->value()) ? TRUE_O : FALSE_O;
     } else if(op == "==") {
         return (left->value() == right->value()) ? TRUE_O : FALSE_O;
     } else {
-        return new object::error("unknown operator: " + std::string(left->type()) + " " + std::string(op) + " " + right->type());
+        return object::error::of(object::UNKNOWN_OPERATOR_ERR, left->type(), op, right->type());
     }
 }
 
 static object::object* eval_integer_infix_expression(object::integer* left, std::string_view op, object::integer* right) noexcept {
-    parser::trace t("eval_infix_int_expr_method: " + left->inspect() + " " + std::string(op) + " " + right->inspect());
+    parser::trace t([&] { return "eval_infix_int_expr_method: " + left->inspect() + " " + std::string(op) + " " + right->inspect(); });
     if(op == "+") {
         return new object::integer(left->value() + right->value());
     } else if(op == "-") {
         return new object::integer(left->value() - right->value());
     } else if(op == "/") {
-        return new object::integer(left->value() / right->value());
+        if(right->value() == 0) {
+            return object::error::of(object::DIVISION_BY_ZERO_ERR, object::INTEGER_OBJ);
+        }
+        return new object::integer(kernels::scalar::apply(kernels::op::div, left->value(), right->value()));
     } else if(op == "*") {
         return new object::integer(left->value() * right->value());
     } else if(op == "<") {
@@ -102,49 +106,125 @@ static object::object* eval_integer_infix_expression(object::integer* left, std:
     } else if(op == "==") {
         return (left->value() == right->value()) ? TRUE_O : FALSE_O;
     } else {
-        return new object::error("unknown operator: " + std::string(left->type()) + " " + std::string(op) + " " + right->type());
+        return object::error::of(object::UNKNOWN_OPERATOR_ERR, left->type(), op, right->type());
     }
 }
 
 static object::object* eval_string_infix_expression(object::string* left, std::string_view op, object::string* right) noexcept {
-    if(op != "+") {
-        return new object::error("unknown operator: " + std::string(left->type()) + " " + std::string(op) + " " + right->type());
+    if(op == "+") {
+        return object::string::concat(left, right);
+    } else if(op == "==") {
+        return left->equals(right) ? TRUE_O : FALSE_O;
+    } else if(op == "!=") {
+        return left->equals(right) ? FALSE_O : TRUE_O;
     }
-    return new object::string(left->value() + right->value());
+    return object::error::of(object::UNKNOWN_OPERATOR_ERR, left->type(), op, right->type());
 }
 
+static object::object* eval_array_infix_expression(object::object* left, std::string_view op, object::object* right) noexcept;
+
 static object::object* eval_infix_expression(object::object* left, std::string_view op, object::object* right) noexcept {
-    parser::trace t("eval_infix_expr_method: " + left->inspect() + " " + std::string(op) + " " + right->inspect());
+    parser::trace t([&] { return "eval_infix_expr_method: " + left->inspect() + " " + std::string(op) + " " + right->inspect(); });
     if(left->type() == object::INTEGER_OBJ && right->type() == object::INTEGER_OBJ) {
-        auto* l = dynamic_cast<object::integer*>(left);
-        auto* r = dynamic_cast<object::integer*>(right);
+        auto* l = object::as<object::integer>(left);
+        auto* r = object::as<object::integer>(right);
         return eval_integer_infix_expression(l, op, r);
     } else if (left->type() == object::BOOLEAN_OBJ && right->type() == object::BOOLEAN_OBJ) {
-        auto* l = dynamic_cast<object::boolean*>(left);
-        auto* r = dynamic_cast<object::boolean*>(right);
+        auto* l = object::as<object::boolean>(left);
+        auto* r = object::as<object::boolean>(right);
         return eval_bool_infix_expression(l, op, r);
     } else if (left->type() == object::STRING_OBJ && right->type() == object::STRING_OBJ) {
-        auto* l = dynamic_cast<object::string*>(left);
-        auto* r = dynamic_cast<object::string*>(right);
+        auto* l = object::as<object::string>(left);
+        auto* r = object::as<object::string>(right);
         return eval_string_infix_expression(l, op, r);
+    } else if (left->type() == object::ARRAY_OBJ || right->type() == object::ARRAY_OBJ) {
+        return eval_array_infix_expression(left, op, right);
     } else if (left->type() != right->type()) {
-        return new object::error("type mismatch: " + std::string(left->type()) + " " + std::string(op) + " " + right->type());
+        return object::error::of(object::TYPE_MISMATCH_ERR, left->type(), op, right->type());
     } else {
-        return new object::error("unknown operator: " + std::string(left->type()) + " " + std::string(op) + " " + right->type());
+        return object::error::of(object::UNKNOWN_OPERATOR_ERR, left->type(), op, right->type());
     }
 }
 
-static bool is_truthy(object::object* o) noexcept {
-    object::object* obj = dynamic_cast<object::boolean*>(o);
-    if (obj == NULL_O || obj == FALSE_O) {
-        return false;
-    } else {
+static std::optional<kernels::op> kernel_op(std::string_view op) noexcept {
+    static const std::pair<std::string_view, kernels::op> ops[] = {
+        {"+", kernels::op::add}, {"-", kernels::op::sub}, {"*", kernels::op::mul}, {"/", kernels::op::div},
+        {"<", kernels::op::lt}, {">", kernels::op::gt}, {"==", kernels::op::eq}, {"!=", kernels::op::ne},
+    };
+    for (const auto& [name, kernel] : ops) {
+        if (name == op) {
+            return kernel;
+        }
+    }
+    return std::nullopt;
+}
+
+/**
+ * Unboxed values of an integer array, or of an integer copied into scalar,
+ * false for anything else.
+ */
+static bool unboxed(object::object* obj, std::int64_t& scalar, std::span<const std::int64_t>& out) noexcept {
+    if (auto n = object::as<object::integer>(obj)) {
+        scalar = n->value();
+        out = std::span<const std::int64_t>(&scalar, 1);
         return true;
     }
+    if (auto arr = object::as<object::array>(obj); arr != nullptr && arr->is_int64()) {
+        out = arr->int64();
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Element-wise operator with an array on at least one side, two arrays must
+ * have the same length and a scalar is combined with every element. Integers
+ * and integer arrays run a kernel over their unboxed values, comparisons make
+ * an array of booleans. Other elements go through eval_infix_expression one
+ * pair at a time, so arrays of arrays broadcast as well.
+ */
+static object::object* eval_array_infix_expression(object::object* left, std::string_view op, object::object* right) noexcept {
+    parser::trace t([&] { return "eval_infix_array_expr_method: " + left->inspect() + " " + std::string(op) + " " + right->inspect(); });
+    object::array* l = object::as<object::array>(left);
+    object::array* r = object::as<object::array>(right);
+    if (l != nullptr && r != nullptr && l->size() != r->size()) {
+        return new object::error(object::LENGTH_MISMATCH_ERR, l->size(), r->size());
+    }
+    std::size_t size = l != nullptr ? l->size() : r->size();
+    std::optional<kernels::op> kernel = kernel_op(op);
+    if (!kernel) {
+        return object::error::of(object::UNKNOWN_OPERATOR_ERR, left->type(), op, right->type());
+    }
+
+    std::int64_t scalars[2];
+    std::span<const std::int64_t> a, b;
+    if (size > 0 && unboxed(left, scalars[0], a) && unboxed(right, scalars[1], b)) {
+        if (*kernel == kernels::op::div && std::find(b.begin(), b.end(), 0) != b.end()) {
+            return object::error::of(object::DIVISION_BY_ZERO_ERR, object::INTEGER_OBJ);
+        }
+        std::vector<std::int64_t> values(size);
+        kernels::elementwise(*kernel, a, b, values);
+        if (*kernel < kernels::op::lt) {
+            return object::array::of_int64(std::move(values));
+        }
+        std::vector<object::object*> mask(size);
+        std::transform(values.begin(), values.end(), mask.begin(), [](std::int64_t v) -> object::object* { return v ? TRUE_O : FALSE_O; });
+        return new object::array(std::move(mask));
+    }
+
+    std::vector<object::object*> elements(size);
+    for (std::size_t i = 0; i < size; i++) {
+        object::object* e = eval_infix_expression(l != nullptr ? l->at(i) : left, op, r != nullptr ? r->at(i) : right);
+        if (is_error(e)) {
+            return e;
+        }
+        elements[i] = e;
+    }
+    return new_array(std::move(elements));
 }
 
 static object::object* eval_if_expression(std::shared_ptr<const ast::if_expression> ie, object::scope* scope) noexcept {
-    parser::trace t("eval if expr: " + ie->to_string());
+    parser::trace t("eval if expr: ", *ie);
     object::object* condition = eval(ie->condition(), scope);
     if (is_error(condition)) {
         return condition;
@@ -159,32 +239,69 @@ static object::object* eval_if_expression(std::shared_ptr<const ast::if_expressi
 }
 
 static object::object* eval_block_statement(std::shared_ptr<const ast::block_statement> block, object::scope* scope) noexcept {
-    parser::trace t("eval block statement: " + block->to_string());
-    object::object* result;
+    parser::trace t("eval block statement: ", *block);
+    object::object* result = nullptr;
     const std::vector<std::shared_ptr<ast::statement>>& stmts = block->statements();
 
     for(const auto& stmt : stmts){
         result = eval(stmt, scope);
-        if (result != nullptr) {
-            object::object_t rt = result->type();
-            if (rt == object::RETURN_VALUE_OBJ || rt == object::ERROR_OBJ) {
-                return result;
-            }
+        if (result != nullptr && result->abrupt()) {
+            return result;
         }
     }
 
     return result;
 }
 
+/**
+ * Loops run in the enclosing scope, so iterations allocate no frames. A return 
+ * or an error in the body ends the loop and is passed on, otherwise the loop 
+ * evaluates to null.
+ */
+static object::object* eval_while_statement(std::shared_ptr<const ast::while_statement> ws, object::scope* scope) noexcept {
+    parser::trace t("eval while stmt: ", *ws);
+    for(;;) {
+        object::object* condition = eval(ws->condition(), scope);
+        if (is_error(condition)) {
+            return condition;
+        }
+        if (!is_truthy(condition)) {
+            return NULL_O;
+        }
+        object::object* result = eval_block_statement(ws->body(), scope);
+        if (result != nullptr && result->abrupt()) {
+            return result;
+        }
+    }
+}
+
+static object::object* eval_for_statement(std::shared_ptr<const ast::for_statement> fs, object::scope* scope) noexcept {
+    parser::trace t("eval for stmt: ", *fs);
+    object::object* iterable = eval(fs->iterable(), scope);
+    if (is_error(iterable)) {
+        return iterable;
+    }
+    if (!evaluator::iterable(iterable)) {
+        return object::error::of(object::FOR_IN_ERR, iterable->type());
+    }
+    std::string name(fs->ident().value());
+    object::object* result = drain(iterable, [&](object::object* x) -> object::object* {
+        scope->set(name, x);
+        object::object* res = eval_block_statement(fs->body(), scope);
+        return res != nullptr && res->abrupt() ? res : nullptr;
+    });
+    return result != nullptr ? result : NULL_O;
+}
+
 static object::object* eval_identifier(std::shared_ptr<const ast::identifier> ident, object::scope* scope) {
-    parser::trace t("eval_identifier: " + ident->to_string());
+    parser::trace t("eval_identifier: ", *ident);
     if(object::object* res = scope->get(std::string(ident->value()))) {
         return res;
     }
     if(object::object* builtin_fn = get_builtin(ident->value())) {
         return builtin_fn;
     }
-    return new object::error("identifier not found: " + std::string(ident->value()));
+    return new object::error(object::IDENTIFIER_ERR, ident->value());
 }
 
 static std::vector<object::object*> eval_expressions(const std::vector<std::shared_ptr<ast::expression>>& exps, 
@@ -203,53 +320,384 @@ static std::vector<object::object*> eval_expressions(const std::vector<std::shar
 }
 
 static object::object* unwrap_return_value(object::object* obj) noexcept {
-    parser::trace t("unwrap_return_value: " + obj->inspect());
-    if (auto o = dynamic_cast<object::return_value*>(obj)) {
+    parser::trace t([&] { return "unwrap_return_value: " + obj->inspect(); });
+    if (auto o = object::as<object::return_value>(obj)) {
         return o->value();
     }
     return obj;
 }
 
-static object::scope* extend_fn_scope(object::function* fn, std::vector<object::object*> args) noexcept {
-    parser::trace t("extend current fn scope: " + fn->get_scope()->list_scope()); 
-    object::scope* extended_scope = new object::scope(fn->get_scope());
+/**
+ * Recycles the frames of calls that cannot escape, a frame is acquired on call
+ * and released on return. Frames that may escape are heap allocated and kept.
+ */
+class frame_region {
+public:
+    static frame_region& local() noexcept {
+        thread_local frame_region region;
+        return region;
+    }
+
+    object::scope* acquire(object::scope* outer, object::captures captured) noexcept {
+        if(_free.empty()) {
+            return new object::scope(outer, captured);
+        }
+        object::scope* frame = _free.back();
+        _free.pop_back();
+        frame->reset(outer, captured);
+        return frame;
+    }
+
+    void release(object::scope* frame) noexcept { _free.push_back(frame); }
+
+    std::size_t free_frames() const noexcept { return _free.size(); }
+
+private:
+    std::vector<object::scope*> _free;
+};
+
+/**
+ * Per-interpreter stack that call arguments are evaluated into. Its storage is
+ * allocated once and never moves, so the arguments of a pending call stay valid
+ * while the callee pushes its own calls above them.
+ */
+class value_stack {
+public:
+    static constexpr std::size_t capacity = 1 << 16;
+
+    static value_stack& local() noexcept {
+        thread_local value_stack stack;
+        return stack;
+    }
+
+    value_stack() : _base(new object::object*[capacity]) {}
+    value_stack(const value_stack&) = delete;
+    value_stack& operator=(const value_stack&) = delete;
+    ~value_stack() noexcept { delete[] _base; }
+
+    std::size_t size() const noexcept { return _top; }
+
+    /**
+     * Pushes obj, false when the stack is full.
+     */
+    bool push(object::object* obj) noexcept {
+        if(_top == capacity) {
+            return false;
+        }
+        _base[_top++] = obj;
+        return true;
+    }
+
+    object::args_t since(std::size_t mark) const noexcept { return object::args_t(_base + mark, _top - mark); }
+    void pop_to(std::size_t mark) noexcept { _top = mark; }
+
+private:
+    object::object**    _base;
+    std::size_t         _top = 0;
+};
+
+/**
+ * Evaluates exps onto the value stack, returns the first error or nullptr. On 
+ * error the stack is left as it was.
+ */
+static object::object* push_arguments(const std::vector<std::shared_ptr<ast::expression>>& exps, 
+        object::scope* scope) noexcept {
+    value_stack& stack = value_stack::local();
+    std::size_t mark = stack.size();
+    for (const auto& exp : exps) {
+        object::object* evaluated = eval(exp, scope);
+        if (is_error(evaluated)) {
+            stack.pop_to(mark);
+            return evaluated;
+        }
+        if (!stack.push(evaluated)) {
+            stack.pop_to(mark);
+            return object::error::of(object::STACK_OVERFLOW_ERR, object::NULL_OBJ);
+        }
+    }
+    return nullptr;
+}
+
+static object::scope* extend_fn_scope(object::function* fn, object::args_t args) noexcept {
+    parser::trace t([&] { return "extend fn scope, captured: " + std::to_string(fn->proto().free_variables.size()); });
+    object::scope* extended_scope = fn->frame_escapes() 
+        ? new object::scope(fn->get_scope(), fn->captured()) 
+        : frame_region::local().acquire(fn->get_scope(), fn->captured());
+    extended_scope->reserve(fn->proto().slots);
     for (int i = 0; i < fn->parameters().size(); i++) {
         extended_scope->set(std::string(fn->parameters()[i]->value()), args[i]);
     }
     return extended_scope;
 }
 
-static object::object* apply_function(object::object* fn, std::vector<object::object*> args) noexcept {
-    parser::trace t("apply function: " + fn->inspect());
-    if (object::function* function = dynamic_cast<object::function*>(fn)) {
+static object::object* apply_function(object::object* fn, object::args_t args) noexcept {
+    parser::trace t([&] { return "apply function: " + fn->inspect(); });
+    if (object::function* function = object::as<object::function>(fn)) {
+        if (args.size() != function->proto().arity) {
+            return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), function->proto().arity);
+        }
         object::scope* extended_scope = extend_fn_scope(function, args);
         object::object* evaluated = eval(function->body(), extended_scope);
+        if(!function->frame_escapes()) {
+            frame_region::local().release(extended_scope);
+        }
 
         return unwrap_return_value(evaluated);
     }
-    if (object::builtin* builtin_fn = dynamic_cast<object::builtin*>(fn)) {
+    if (object::builtin* builtin_fn = object::as<object::builtin>(fn)) {
         return builtin_fn->fn()(args);
     }
 
-    return new object::error("not a function: " + std::string(fn->type()));
+    return object::error::of(object::NOT_A_FUNCTION_ERR, fn->type());
+}
+
+inline callback::callback(object::object* fn) noexcept : _fn(fn) {
+    object::function* function = object::as<object::function>(fn);
+    if (function == nullptr || function->frame_escapes() || function->proto().slots != function->proto().arity) {
+        return;
+    }
+    _function = function;
+    _frame = frame_region::local().acquire(function->get_scope(), function->captured());
+    _frame->reserve(function->proto().slots);
+    for (const auto& param : function->parameters()) {
+        std::string name(param->value());
+        _frame->set(name, NULL_O);
+        _params.push_back(_frame->slot(name));
+    }
+}
+
+inline callback::~callback() noexcept {
+    if (_frame != nullptr) {
+        frame_region::local().release(_frame);
+    }
+}
+
+inline object::object* callback::operator()(object::args_t args) noexcept {
+    if (_frame == nullptr || args.size() != _params.size()) {
+        return apply_function(_fn, args);
+    }
+    for (std::size_t i = 0; i < args.size(); i++) {
+        *_params[i] = args[i];
+    }
+    return unwrap_return_value(eval(_function->body(), _frame));
+}
+
+/**
+ * Creates the closure for fn, pointing its free variables at their bindings.
+ */
+static object::object* eval_function_literal(std::shared_ptr<const ast::function_literal> fn, 
+        object::scope* scope) noexcept {
+    const std::shared_ptr<const ast::prototype>& proto = ast::prototype::of(*fn);
+    object::function* closure = new object::function(proto, nullptr);
+    for(std::size_t i = 0; i < proto->free_variables.size(); i++) {
+        const std::string& name = proto->free_variables[i];
+        object::object** slot = scope->slot(name);
+        if(slot == nullptr && get_builtin(name) == nullptr) {
+            closure->set_scope(scope);
+        }
+        closure->capture(i, slot);
+    }
+    return closure;
+}
+
+/**
+ * Binds fn to the let binding slot of name, and drops its fallback scope if 
+ * nothing else was unresolved.
+ */
+static void bind_self(object::function* fn, const std::string& name, object::scope* scope) noexcept {
+    fn->bind_self(name, scope->slot(name));
+    const std::vector<std::string>& names = fn->proto().free_variables;
+    for(std::size_t i = 0; i < names.size(); i++) {
+        if(fn->captured().slots[i] == nullptr && get_builtin(names[i]) == nullptr) {
+            return;
+        }
+    }
+    fn->set_scope(nullptr);
 }
 
 static object::object* eval_array_index_expression(object::object* array, object::object* index) noexcept {
-    parser::trace t("eval_array_index_expr method: " + array->inspect() + " " + index->inspect());
-    object::array* array_obj = dynamic_cast<object::array*>(array);
-    std::int64_t idx = dynamic_cast<object::integer*>(index)->value();
-    if (idx < 0 || idx > array_obj->elements().size() - 1) {
+    parser::trace t([&] { return "eval_array_index_expr method: " + array->inspect() + " " + index->inspect(); });
+    object::array* array_obj = object::as<object::array>(array);
+    std::int64_t idx = object::as<object::integer>(index)->value();
+    if (idx < 0 || static_cast<std::size_t>(idx) >= array_obj->size()) {
         return NULL_O;
     }
-    return array_obj->elements()[idx].get();
+    return array_obj->at(idx);
+}
+
+/**
+ * array[mask], the elements whose entry in the boolean array mask is true, as
+ * made by a comparison on array.
+ */
+static object::object* eval_mask_index_expression(object::array* array, object::array* mask) noexcept {
+    if (array->size() != mask->size()) {
+        return new object::error(object::LENGTH_MISMATCH_ERR, array->size(), mask->size());
+    }
+    std::vector<object::object*> elements;
+    for (std::size_t i = 0; i < mask->size(); i++) {
+        object::object* keep = mask->at(i);
+        if (keep->type() != object::BOOLEAN_OBJ) {
+            return object::error::of(object::INDEX_OPERATOR_ERR, object::ARRAY_OBJ, {}, keep->type());
+        }
+        if (object::as<object::boolean>(keep)->value()) {
+            elements.push_back(array->at(i));
+        }
+    }
+    return new_array(std::move(elements));
 }
 
 static object::object* eval_index_expression(object::object* left, object::object* index) noexcept {
-    parser::trace t("eval_index_expr method: " + left->inspect() + " " + index->inspect());
+    parser::trace t([&] { return "eval_index_expr method: " + left->inspect() + " " + index->inspect(); });
     if(left->type() == object::ARRAY_OBJ && index->type() == object::INTEGER_OBJ) {
         return eval_array_index_expression(left, index);
     }
-    return new object::error("index operator not supported: " + std::string(left->type()) + " " + std::string(index->type()));
+    if(left->type() == object::ARRAY_OBJ && index->type() == object::ARRAY_OBJ) {
+        return eval_mask_index_expression(object::as<object::array>(left), object::as<object::array>(index));
+    }
+    if(left->type() == object::STRING_OBJ && index->type() == object::INTEGER_OBJ) {
+        object::object* c = object::as<object::string>(left)->at(object::as<object::integer>(index)->value());
+        return c != nullptr ? c : NULL_O;
+    }
+    if(left->type() == object::RANGE_OBJ && index->type() == object::INTEGER_OBJ) {
+        auto* r = object::as<object::range>(left);
+        std::int64_t idx = object::as<object::integer>(index)->value();
+        return idx >= 0 && static_cast<std::size_t>(idx) < r->size() ? static_cast<object::object*>(new object::integer(r->at(idx))) : NULL_O;
+    }
+    if(auto hash = object::as<object::hash_map>(left)) {
+        if(!object::hash_map::hashable(index)) {
+            return object::error::of(object::HASH_KEY_ERR, index->type());
+        }
+        object::object* value = hash->get(index);
+        return value != nullptr ? value : NULL_O;
+    }
+    return object::error::of(object::INDEX_OPERATOR_ERR, left->type(), {}, index->type());
+}
+
+static object::object* eval_hash_literal(std::shared_ptr<const ast::hash_literal> n, object::scope* scope) noexcept {
+    object::hash_map* hash = new object::hash_map();
+    hash->reserve(n->pairs().size());
+    for (const auto& [key_expr, value_expr] : n->pairs()) {
+        object::object* key = eval(key_expr, scope);
+        if (is_error(key)) {
+            return key;
+        }
+        if (!object::hash_map::hashable(key)) {
+            return object::error::of(object::HASH_KEY_ERR, key->type());
+        }
+        object::object* value = eval(value_expr, scope);
+        if (is_error(value)) {
+            return value;
+        }
+        hash->set(key, value);
+    }
+    return hash;
+}
+
+/**
+ * left[begin:end] on an array or a string, a null bound was left out and means
+ * the start or the end. The result shares the storage of left, see 
+ * object::array::slice() and object::string::slice().
+ */
+static object::object* slice(object::object* left, object::object* begin, object::object* end) noexcept {
+    std::int64_t bounds[2] = {0, std::numeric_limits<std::int64_t>::max()};
+    object::object* given[2] = {begin, end};
+    for (int i = 0; i < 2; i++) {
+        if (given[i] == nullptr) {
+            continue;
+        }
+        object::integer* value = object::as<object::integer>(given[i]);
+        if (value == nullptr) {
+            return object::error::of(object::SLICE_OPERATOR_ERR, left->type(), {}, given[i]->type());
+        }
+        bounds[i] = value->value();
+    }
+    if (auto* array = object::as<object::array>(left)) {
+        return array->slice(bounds[0], bounds[1]);
+    }
+    if (auto* str = object::as<object::string>(left)) {
+        return str->slice(bounds[0], bounds[1]);
+    }
+    return object::error::of(object::SLICE_OPERATOR_ERR, left->type(), {}, object::INTEGER_OBJ);
+}
+
+static object::object* eval_slice_expression(std::shared_ptr<const ast::slice_expression> n, 
+        object::scope* scope) noexcept {
+    object::object* operands[3] = {};
+    std::shared_ptr<const ast::expression> exprs[3] = {n->left(), n->begin(), n->end()};
+    for (int i = 0; i < 3; i++) {
+        if (exprs[i] == nullptr) {
+            continue;
+        }
+        operands[i] = eval(exprs[i], scope);
+        if (is_error(operands[i])) {
+            return operands[i];
+        }
+    }
+    return slice(operands[0], operands[1], operands[2]);
+}
+
+/**
+ * left[index] = value(), an array element is replaced in place, a hash entry 
+ * is bound. value is only evaluated once left[index] is known to be assignable.
+ */
+template <typename Value>
+static object::object* assign_element(object::object* left, object::object* index, Value value) noexcept {
+    if (auto hash = object::as<object::hash_map>(left)) {
+        if (!object::hash_map::hashable(index)) {
+            return object::error::of(object::HASH_KEY_ERR, index->type());
+        }
+        object::object* val = value();
+        if (is_error(val)) {
+            return val;
+        }
+        hash->set(index, val);
+        return val;
+    }
+    object::array* array = object::as<object::array>(left);
+    object::integer* idx = object::as<object::integer>(index);
+    if (array == nullptr || idx == nullptr) {
+        return object::error::of(object::INDEX_ASSIGNMENT_ERR, left->type(), {}, index->type());
+    }
+    if (idx->value() < 0 || static_cast<std::size_t>(idx->value()) >= array->size()) {
+        return new object::error(object::INDEX_RANGE_ERR, idx->value());
+    }
+    object::object* val = value();
+    if (is_error(val)) {
+        return val;
+    }
+    array->set(idx->value(), val);
+    return val;
+}
+
+/**
+ * Evaluates target = value. An identifier is rebound in the scope that defines
+ * it, an element is assigned with assign_element(). Yields the assigned value.
+ */
+static object::object* eval_assign_expression(std::shared_ptr<const ast::assign_expression> n, 
+        object::scope* scope) noexcept {
+    if (auto ident = std::dynamic_pointer_cast<const ast::identifier>(n->target())) {
+        object::object* val = eval(n->value(), scope);
+        if (is_error(val)) {
+            return val;
+        }
+        if (scope->assign(std::string(ident->value()), val) == nullptr) {
+            return new object::error(object::IDENTIFIER_ERR, ident->value());
+        }
+        return val;
+    }
+    auto target = std::dynamic_pointer_cast<const ast::index_expression>(n->target());
+    if (target == nullptr) {
+        return new object::error(object::ASSIGN_TARGET_ERR, n->target()->to_string());
+    }
+    object::object* left = eval(target->left(), scope);
+    if (is_error(left)) {
+        return left;
+    }
+    object::object* index = eval(target->index(), scope);
+    if (is_error(index)) {
+        return index;
+    }
+    return assign_element(left, index, [&] { return eval(n->value(), scope); });
 }
 
 static object::object* eval(std::shared_ptr<const ast::node> node, object::scope* scope) {
@@ -272,7 +720,12 @@ static object::object* eval(std::shared_ptr<const ast::node> node, object::scope
     }
     if (auto n = std::dynamic_pointer_cast<const ast::string_literal>(node)) {
         parser::trace t("eval_string_lit");
-        return new object::string(n->value());
+        object::string* constant = n->constant();
+        if (constant == nullptr) {
+            constant = object::string::intern(n->value());
+            n->set_constant(constant);
+        }
+        return constant;
     }
     if (auto n = std::dynamic_pointer_cast<const ast::let_statement>(node)) {
         parser::trace t("eval_let_stmt");
@@ -281,6 +734,9 @@ static object::object* eval(std::shared_ptr<const ast::node> node, object::scope
             return val;
         }
         scope->set(std::string(n->ident().value()), val);
+        if (std::dynamic_pointer_cast<const ast::function_literal>(n->value()) != nullptr) {
+            bind_self(object::as<object::function>(val), std::string(n->ident().value()), scope);
+        }
     }
     if (auto n = std::dynamic_pointer_cast<const ast::prefix_expression>(node)) {
         parser::trace t("eval_prefix_expr");
@@ -312,11 +768,11 @@ static object::object* eval(std::shared_ptr<const ast::node> node, object::scope
         if (is_error(val)) {
             return val;
         }
-        return new object::return_value(std::shared_ptr<object::object>(val));
+        return new object::return_value(val);
     }
     if (auto n = std::dynamic_pointer_cast<const ast::function_literal>(node)) {
         parser::trace t("eval_fn_lit");
-        return new object::function(n->move_parameters(), n->body(), scope);
+        return eval_function_literal(n, scope);
     }
     if (auto n = std::dynamic_pointer_cast<const ast::call_expression>(node)) {
         parser::trace t("eval_call_expr");
@@ -324,11 +780,22 @@ static object::object* eval(std::shared_ptr<const ast::node> node, object::scope
         if (is_error(fn)) {
             return fn;
         }
-        std::vector<object::object*> args = eval_expressions(n->arguments(), scope);
-        if (args.size() == 1 && is_error(args[0])) {
-            return args[0];
+        value_stack& stack = value_stack::local();
+        std::size_t mark = stack.size();
+        if (object::object* err = push_arguments(n->arguments(), scope)) {
+            return err;
         }
-        return apply_function(fn, args);
+        object::object* res = apply_function(fn, stack.since(mark));
+        stack.pop_to(mark);
+        return res;
+    }
+    if (auto n = std::dynamic_pointer_cast<const ast::while_statement>(node)) {
+        parser::trace t("eval_while_stmt");
+        return eval_while_statement(n, scope);
+    }
+    if (auto n = std::dynamic_pointer_cast<const ast::for_statement>(node)) {
+        parser::trace t("eval_for_stmt");
+        return eval_for_statement(n, scope);
     }
     if (auto n = std::dynamic_pointer_cast<const ast::if_expression>(node)) {
         parser::trace t("eval_if_expr");
@@ -348,7 +815,11 @@ static object::object* eval(std::shared_ptr<const ast::node> node, object::scope
         if(elements.size() == 1 && is_error(elements[0])) {
             return elements[0];
         }
-        return new object::array(elements);
+        return new_array(std::move(elements));
+    }
+    if (auto n = std::dynamic_pointer_cast<const ast::hash_literal>(node)) {
+        parser::trace t("eval_hash_lit");
+        return eval_hash_literal(n, scope);
     }
     if (auto n = std::dynamic_pointer_cast<const ast::index_expression>(node)) {
         parser::trace t("eval_index_expr");
@@ -362,6 +833,14 @@ static object::object* eval(std::shared_ptr<const ast::node> node, object::scope
         }
         return eval_index_expression(left, index);
     }
+    if (auto n = std::dynamic_pointer_cast<const ast::slice_expression>(node)) {
+        parser::trace t("eval_slice_expr");
+        return eval_slice_expression(n, scope);
+    }
+    if (auto n = std::dynamic_pointer_cast<const ast::assign_expression>(node)) {
+        parser::trace t("eval_assign_expr");
+        return eval_assign_expression(n, scope);
+    }
 
     return nullptr;
 }
@@ -0,0 +1,750 @@
+#pragma once
+
+#include "ast.hpp"
+#include "object.hpp"
+#include "evaluator.hpp"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Compact, index based alternative to the ast:: tree. Nodes live in contiguous
+ * arrays and reference their children by 32-bit index, leaf payloads (ints,
+ * symbol ids, string table offsets) are stored inline in the operand slots.
+ */
+namespace flat {
+
+using node_id = std::uint32_t;
+using symbol_t = std::uint32_t;
+using kind_t = std::uint8_t;
+using op_t = std::uint8_t;
+
+constexpr node_id NIL = UINT32_MAX;
+
+constexpr kind_t PROGRAM    = 0;
+constexpr kind_t LET        = 1;
+constexpr kind_t RETURN     = 2;
+constexpr kind_t EXPR_STMT  = 3;
+constexpr kind_t BLOCK      = 4;
+constexpr kind_t IDENT      = 5;
+constexpr kind_t INT        = 6;
+constexpr kind_t BOOLEAN    = 7;
+constexpr kind_t STRING     = 8;
+constexpr kind_t PREFIX     = 9;
+constexpr kind_t INFIX      = 10;
+constexpr kind_t IF         = 11;
+constexpr kind_t FUNCTION   = 12;
+constexpr kind_t CALL       = 13;
+constexpr kind_t ARRAY      = 14;
+constexpr kind_t INDEX      = 15;
+constexpr kind_t WHILE      = 16;
+constexpr kind_t FOR        = 17;
+constexpr kind_t ASSIGN     = 18;
+constexpr kind_t SLICE      = 19;
+constexpr kind_t HASH       = 20;
+
+constexpr op_t OP_NONE  = 0;
+constexpr op_t OP_PLUS  = 1;
+constexpr op_t OP_MINUS = 2;
+constexpr op_t OP_MUL   = 3;
+constexpr op_t OP_DIV   = 4;
+constexpr op_t OP_LT    = 5;
+constexpr op_t OP_GT    = 6;
+constexpr op_t OP_EQ    = 7;
+constexpr op_t OP_NEQ   = 8;
+constexpr op_t OP_BANG  = 9;
+
+const std::array<std::string_view, 10> op_names {
+    "", "+", "-", "*", "/", "<", ">", "==", "!=", "!"
+};
+
+inline op_t lookup_op(std::string_view op) noexcept {
+    for(op_t i = 1; i < op_names.size(); i++) {
+        if(op_names[i] == op) {
+            return i;
+        }
+    }
+    return OP_NONE;
+}
+
+/**
+ * Operand slots of a node, their meaning depends on the node kind:
+ *
+ *  PROGRAM, BLOCK  a = first entry in the list pool, b = statement count
+ *  LET             a = symbol, b = value
+ *  RETURN          a = value (NIL if none)
+ *  EXPR_STMT       a = expression
+ *  IDENT           a = symbol
+ *  INT             a = low 32 bits, b = high 32 bits
+ *  BOOLEAN         a = value
+ *  STRING          a = offset into the string table, b = length, c = constant index
+ *  PREFIX          a = operand
+ *  INFIX           a = left, b = right
+ *  IF              a = condition, b = consequence, c = alternative (NIL if none)
+ *  FUNCTION        a = first parameter symbol in the list pool, b = parameter count, c = body
+ *  CALL            a = callee, b = first argument in the list pool, c = argument count
+ *  ARRAY           a = first element in the list pool, b = element count
+ *  INDEX           a = left, b = index
+ *  WHILE           a = condition, b = body
+ *  FOR             a = symbol, b = iterable, c = body
+ *  ASSIGN          a = target, an IDENT or INDEX node, b = value
+ *  SLICE           a = left, b = begin, c = end (NIL if left out)
+ *  HASH            a = first key in the list pool, each followed by its value, b = pair count
+ */
+struct operands {
+    std::uint32_t a = NIL;
+    std::uint32_t b = NIL;
+    std::uint32_t c = NIL;
+};
+
+class program {
+public:
+    node_id root() const noexcept { return _root; }
+    std::size_t size() const noexcept { return _kinds.size(); }
+
+    kind_t kind(node_id n) const noexcept { return _kinds[n]; }
+    op_t op(node_id n) const noexcept { return _ops[n]; }
+    const operands& slots(node_id n) const noexcept { return _slots[n]; }
+
+    std::int64_t int_value(node_id n) const noexcept {
+        return static_cast<std::int64_t>(static_cast<std::uint64_t>(_slots[n].b) << 32 | _slots[n].a);
+    }
+    std::string_view string_value(node_id n) const noexcept {
+        return std::string_view(_strings).substr(_slots[n].a, _slots[n].b);
+    }
+    std::string_view symbol_name(symbol_t s) const noexcept { return _symbol_names[s]; }
+
+    /**
+     * Interned runtime string of the string literal n, materialised on first
+     * use into the program's constant pool.
+     */
+    object::string* constant(node_id n) const noexcept {
+        object::string*& c = _constants[_slots[n].c];
+        if(c == nullptr) {
+            c = object::string::intern(string_value(n));
+        }
+        return c;
+    }
+    std::uint32_t list(std::uint32_t i) const noexcept { return _lists[i]; }
+
+    /**
+     * Bytes held by the node arrays, list pool, string, constant and symbol tables.
+     */
+    std::size_t bytes() const noexcept {
+        std::size_t total = sizeof(program);
+        total += _kinds.capacity() * sizeof(kind_t) + _ops.capacity() * sizeof(op_t);
+        total += _slots.capacity() * sizeof(operands) + _lists.capacity() * sizeof(std::uint32_t);
+        total += _strings.capacity() + _constants.capacity() * sizeof(object::string*);
+        for(const std::string& name : _symbol_names) {
+            total += sizeof(std::string) + name.capacity();
+        }
+        return total;
+    }
+
+    const std::string to_string() const noexcept {
+        std::string buf;
+        write(_root, buf);
+        return buf;
+    }
+
+    /**
+     * Printed form of the function literal n, built on first use and kept for 
+     * the lifetime of the program.
+     */
+    const std::string& function_string(node_id n) const noexcept {
+        auto it = _function_strings.find(n);
+        if(it == _function_strings.end()) {
+            std::string buf;
+            write(n, buf);
+            it = _function_strings.emplace(n, std::move(buf)).first;
+        }
+        return it->second;
+    }
+
+    void write(node_id n, std::string& buf) const noexcept {
+        if(n == NIL) {
+            return;
+        }
+        const operands& s = _slots[n];
+        switch(_kinds[n]) {
+        case PROGRAM:
+        case BLOCK:
+            for(std::uint32_t i = 0; i < s.b; i++) {
+                write(_lists[s.a + i], buf);
+            }
+            break;
+        case LET:
+            buf += "let ";
+            buf += _symbol_names[s.a];
+            buf += " = ";
+            write(s.b, buf);
+            buf += ";";
+            break;
+        case RETURN:
+            buf += "return ";
+            write(s.a, buf);
+            buf += ";";
+            break;
+        case EXPR_STMT:
+            write(s.a, buf);
+            break;
+        case IDENT:
+            buf += _symbol_names[s.a];
+            break;
+        case INT:
+            buf += std::to_string(int_value(n));
+            break;
+        case BOOLEAN:
+            buf += s.a ? "true" : "false";
+            break;
+        case STRING:
+            buf += string_value(n);
+            break;
+        case PREFIX:
+            buf += "(";
+            buf += op_names[_ops[n]];
+            write(s.a, buf);
+            buf += ")";
+            break;
+        case INFIX:
+            buf += "(";
+            write(s.a, buf);
+            buf += " ";
+            buf += op_names[_ops[n]];
+            buf += " ";
+            write(s.b, buf);
+            buf += ")";
+            break;
+        case IF:
+            buf += "if";
+            write(s.a, buf);
+            buf += " ";
+            write(s.b, buf);
+            if(s.c != NIL) {
+                buf += "else ";
+                write(s.c, buf);
+            }
+            break;
+        case FUNCTION:
+            buf += "fn(";
+            for(std::uint32_t i = 0; i < s.b; i++) {
+                buf += _symbol_names[_lists[s.a + i]];
+                buf += ",";
+            }
+            buf += ")";
+            write(s.c, buf);
+            break;
+        case CALL:
+            write(s.a, buf);
+            buf += "(";
+            for(std::uint32_t i = 0; i < s.c; i++) {
+                write(_lists[s.b + i], buf);
+                if(i != s.c - 1) { buf += ", "; }
+            }
+            buf += ")";
+            break;
+        case ARRAY:
+            buf += "[";
+            for(std::uint32_t i = 0; i < s.b; i++) {
+                write(_lists[s.a + i], buf);
+                if(i != s.b - 1) { buf += ", "; }
+            }
+            buf += "]";
+            break;
+        case INDEX:
+            buf += "(";
+            write(s.a, buf);
+            buf += "[";
+            write(s.b, buf);
+            buf += "])";
+            break;
+        case WHILE:
+            buf += "while";
+            write(s.a, buf);
+            buf += " ";
+            write(s.b, buf);
+            break;
+        case FOR:
+            buf += "for(";
+            buf += _symbol_names[s.a];
+            buf += " in ";
+            write(s.b, buf);
+            buf += ") ";
+            write(s.c, buf);
+            break;
+        case ASSIGN:
+            buf += "(";
+            write(s.a, buf);
+            buf += " = ";
+            write(s.b, buf);
+            buf += ")";
+            break;
+        case SLICE:
+            buf += "(";
+            write(s.a, buf);
+            buf += "[";
+            write(s.b, buf);
+            buf += ":";
+            write(s.c, buf);
+            buf += "])";
+            break;
+        case HASH:
+            buf += "{";
+            for(std::uint32_t i = 0; i < s.b; i++) {
+                write(_lists[s.a + 2 * i], buf);
+                buf += ": ";
+                write(_lists[s.a + 2 * i + 1], buf);
+                if(i != s.b - 1) { buf += ", "; }
+            }
+            buf += "}";
+            break;
+        }
+    }
+
+protected:
+    friend class builder;
+
+    node_id                                     _root = NIL;
+    std::vector<kind_t>                         _kinds;
+    std::vector<op_t>                           _ops;
+    std::vector<operands>                       _slots;
+    std::vector<std::uint32_t>                  _lists;         // child ids and parameter symbols
+    std::string                                 _strings;       // contents of all string literals
+    std::vector<std::string>                    _symbol_names;
+    mutable std::unordered_map<node_id, std::string> _function_strings;
+    mutable std::vector<object::string*>        _constants;     // one per string literal
+};
+
+/**
+ * Converts an ast::program into its flat representation. Children are always
+ * converted before their parent, so the ids of a node's list entries are
+ * contiguous in the list pool.
+ */
+class builder {
+public:
+    program build(const ast::program& p) noexcept {
+        _program = program();
+        std::vector<std::uint32_t> stmts;
+        for(const auto& stmt : p.statements()) {
+            stmts.push_back(convert(stmt.get()));
+        }
+        _program._root = add(PROGRAM, OP_NONE, {push_list(stmts), static_cast<std::uint32_t>(stmts.size())});
+
+        _program._kinds.shrink_to_fit();
+        _program._ops.shrink_to_fit();
+        _program._slots.shrink_to_fit();
+        _program._lists.shrink_to_fit();
+        _program._strings.shrink_to_fit();
+        _program._constants.shrink_to_fit();
+        return std::move(_program);
+    }
+
+    std::vector<std::string> errors() const noexcept { return _errors; }
+
+private:
+    node_id add(kind_t kind, op_t op, operands slots) {
+        _program._kinds.push_back(kind);
+        _program._ops.push_back(op);
+        _program._slots.push_back(slots);
+        return _program._kinds.size() - 1;
+    }
+
+    std::uint32_t push_list(const std::vector<std::uint32_t>& entries) {
+        std::uint32_t start = _program._lists.size();
+        _program._lists.insert(_program._lists.end(), entries.begin(), entries.end());
+        return start;
+    }
+
+    symbol_t intern(std::string_view name) {
+        auto it = _symbols.find(std::string(name));
+        if(it != _symbols.end()) {
+            return it->second;
+        }
+        symbol_t s = _program._symbol_names.size();
+        _program._symbol_names.push_back(std::string(name));
+        _symbols.emplace(std::string(name), s);
+        return s;
+    }
+
+    node_id convert_block(const ast::block_statement* block) {
+        if(block == nullptr) {
+            return NIL;
+        }
+        std::vector<std::uint32_t> stmts;
+        for(const auto& stmt : block->statements()) {
+            stmts.push_back(convert(stmt.get()));
+        }
+        return add(BLOCK, OP_NONE, {push_list(stmts), static_cast<std::uint32_t>(stmts.size())});
+    }
+
+    template <typename T>
+    std::vector<std::uint32_t> convert_all(const std::vector<std::shared_ptr<T>>& nodes) {
+        std::vector<std::uint32_t> ids;
+        for(const auto& n : nodes) {
+            ids.push_back(convert(n.get()));
+        }
+        return ids;
+    }
+
+    node_id convert(const ast::node* node) {
+        if(node == nullptr) {
+            return NIL;
+        }
+        if(auto n = dynamic_cast<const ast::let_statement*>(node)) {
+            symbol_t s = intern(n->ident().value());
+            return add(LET, OP_NONE, {s, convert(n->value().get())});
+        }
+        if(auto n = dynamic_cast<const ast::return_statement*>(node)) {
+            return add(RETURN, OP_NONE, {convert(n->return_value().get())});
+        }
+        if(auto n = dynamic_cast<const ast::expression_statement*>(node)) {
+            return add(EXPR_STMT, OP_NONE, {convert(n->expr().get())});
+        }
+        if(auto n = dynamic_cast<const ast::block_statement*>(node)) {
+            return convert_block(n);
+        }
+        if(auto n = dynamic_cast<const ast::identifier*>(node)) {
+            return add(IDENT, OP_NONE, {intern(n->value())});
+        }
+        if(auto n = dynamic_cast<const ast::int_literal*>(node)) {
+            std::uint64_t v = static_cast<std::uint64_t>(n->value());
+            return add(INT, OP_NONE, {static_cast<std::uint32_t>(v), static_cast<std::uint32_t>(v >> 32)});
+        }
+        if(auto n = dynamic_cast<const ast::boolean*>(node)) {
+            return add(BOOLEAN, OP_NONE, {n->value()});
+        }
+        if(auto n = dynamic_cast<const ast::string_literal*>(node)) {
+            std::uint32_t offset = _program._strings.size();
+            std::uint32_t constant = _program._constants.size();
+            _program._strings += n->value();
+            _program._constants.push_back(nullptr);
+            return add(STRING, OP_NONE, {offset, static_cast<std::uint32_t>(n->value().size()), constant});
+        }
+        if(auto n = dynamic_cast<const ast::prefix_expression*>(node)) {
+            return add(PREFIX, lookup_op(n->op()), {convert(n->expr().get())});
+        }
+        if(auto n = dynamic_cast<const ast::infix_expression*>(node)) {
+            node_id l = convert(n->l_expr().get());
+            node_id r = convert(n->r_expr().get());
+            return add(INFIX, lookup_op(n->op()), {l, r});
+        }
+        if(auto n = dynamic_cast<const ast::if_expression*>(node)) {
+            node_id condition = convert(n->condition().get());
+            node_id consequence = convert_block(n->consequence().get());
+            node_id alternative = convert_block(n->alternative().get());
+            return add(IF, OP_NONE, {condition, consequence, alternative});
+        }
+        if(auto n = dynamic_cast<const ast::function_literal*>(node)) {
+            std::vector<std::uint32_t> params;
+            for(const auto& param : n->parameters()) {
+                params.push_back(intern(param->value()));
+            }
+            node_id body = convert_block(n->body().get());
+            return add(FUNCTION, OP_NONE, {push_list(params), static_cast<std::uint32_t>(params.size()), body});
+        }
+        if(auto n = dynamic_cast<const ast::call_expression*>(node)) {
+            node_id callee = convert(n->function().get());
+            std::vector<std::uint32_t> args = convert_all(n->arguments());
+            return add(CALL, OP_NONE, {callee, push_list(args), static_cast<std::uint32_t>(args.size())});
+        }
+        if(auto n = dynamic_cast<const ast::array_literal*>(node)) {
+            std::vector<std::uint32_t> elements = convert_all(n->elements());
+            return add(ARRAY, OP_NONE, {push_list(elements), static_cast<std::uint32_t>(elements.size())});
+        }
+        if(auto n = dynamic_cast<const ast::index_expression*>(node)) {
+            node_id left = convert(n->left().get());
+            node_id index = convert(n->index().get());
+            return add(INDEX, OP_NONE, {left, index});
+        }
+        if(auto n = dynamic_cast<const ast::while_statement*>(node)) {
+            node_id condition = convert(n->condition().get());
+            node_id body = convert_block(n->body().get());
+            return add(WHILE, OP_NONE, {condition, body});
+        }
+        if(auto n = dynamic_cast<const ast::for_statement*>(node)) {
+            symbol_t s = intern(n->ident().value());
+            node_id iterable = convert(n->iterable().get());
+            node_id body = convert_block(n->body().get());
+            return add(FOR, OP_NONE, {s, iterable, body});
+        }
+        if(auto n = dynamic_cast<const ast::assign_expression*>(node)) {
+            node_id target = convert(n->target().get());
+            node_id value = convert(n->value().get());
+            return add(ASSIGN, OP_NONE, {target, value});
+        }
+        if(auto n = dynamic_cast<const ast::slice_expression*>(node)) {
+            node_id left = convert(n->left().get());
+            node_id begin = convert(n->begin().get());
+            node_id end = convert(n->end().get());
+            return add(SLICE, OP_NONE, {left, begin, end});
+        }
+        if(auto n = dynamic_cast<const ast::hash_literal*>(node)) {
+            std::vector<std::uint32_t> entries;
+            for(const auto& [key, value] : n->pairs()) {
+                entries.push_back(convert(key.get()));
+                entries.push_back(convert(value.get()));
+            }
+            return add(HASH, OP_NONE, {push_list(entries), static_cast<std::uint32_t>(n->pairs().size())});
+        }
+        _errors.push_back("flat: unsupported node " + node->to_string());
+        return NIL;
+    }
+
+    program                                     _program;
+    std::unordered_map<std::string, symbol_t>   _symbols;
+    std::vector<std::string>                    _errors;
+};
+
+inline program flatten(const ast::program& p) noexcept { return builder().build(p); }
+
+static object::object* eval(const program& p, node_id n, object::scope* scope);
+
+static object::object* eval_statements(const program& p, node_id n, object::scope* scope, bool unwrap) {
+    const operands& s = p.slots(n);
+    object::object* result = nullptr;
+    for(std::uint32_t i = 0; i < s.b; i++) {
+        result = eval(p, p.list(s.a + i), scope);
+        if(result != nullptr && result->abrupt()) {
+            auto* rv = object::as<object::return_value>(result);
+            return rv != nullptr && unwrap ? rv->value() : result;
+        }
+    }
+    return result;
+}
+
+static object::object* apply_function(object::object* fn, object::args_t args) noexcept {
+    if(auto* f = object::as<object::flat_function>(fn)) {
+        const program& p = *f->get_program();
+        const operands& s = p.slots(f->literal());
+        if(args.size() != s.b) {
+            return new object::error(object::ARGUMENT_COUNT_ERR, args.size(), s.b);
+        }
+        object::scope* extended_scope = new object::scope(f->get_scope());
+        for(std::uint32_t i = 0; i < s.b; i++) {
+            extended_scope->set(std::string(p.symbol_name(p.list(s.a + i))), args[i]);
+        }
+        return evaluator::unwrap_return_value(eval(p, s.c, extended_scope));
+    }
+    return evaluator::apply_function(fn, args);
+}
+
+static object::object* eval(const program& p, node_id n, object::scope* scope) {
+    if(n == NIL) {
+        return nullptr;
+    }
+    const operands& s = p.slots(n);
+    switch(p.kind(n)) {
+    case PROGRAM:
+        return eval_statements(p, n, scope, true);
+    case BLOCK:
+        return eval_statements(p, n, scope, false);
+    case LET: {
+        object::object* val = eval(p, s.b, scope);
+        if(evaluator::is_error(val)) {
+            return val;
+        }
+        scope->set(std::string(p.symbol_name(s.a)), val);
+        return nullptr;
+    }
+    case RETURN: {
+        object::object* val = eval(p, s.a, scope);
+        if(evaluator::is_error(val)) {
+            return val;
+        }
+        return new object::return_value(val);
+    }
+    case EXPR_STMT:
+        return eval(p, s.a, scope);
+    case IDENT: {
+        std::string_view name = p.symbol_name(s.a);
+        if(object::object* res = scope->get(std::string(name))) {
+            return res;
+        }
+        if(object::object* builtin_fn = evaluator::get_builtin(name)) {
+            return builtin_fn;
+        }
+        return new object::error(object::IDENTIFIER_ERR, name);
+    }
+    case INT:
+        return new object::integer(p.int_value(n));
+    case BOOLEAN:
+        return s.a ? evaluator::TRUE_O : evaluator::FALSE_O;
+    case STRING:
+        return p.constant(n);
+    case PREFIX: {
+        object::object* right = eval(p, s.a, scope);
+        if(evaluator::is_error(right)) {
+            return right;
+        }
+        return evaluator::eval_prefix_expression(op_names[p.op(n)], right);
+    }
+    case INFIX: {
+        object::object* left = eval(p, s.a, scope);
+        if(evaluator::is_error(left)) {
+            return left;
+        }
+        object::object* right = eval(p, s.b, scope);
+        if(evaluator::is_error(right)) {
+            return right;
+        }
+        return evaluator::eval_infix_expression(left, op_names[p.op(n)], right);
+    }
+    case IF: {
+        object::object* condition = eval(p, s.a, scope);
+        if(evaluator::is_error(condition)) {
+            return condition;
+        }
+        if(evaluator::is_truthy(condition)) {
+            return eval(p, s.b, scope);
+        } else if(s.c != NIL) {
+            return eval(p, s.c, scope);
+        }
+        return evaluator::NULL_O;
+    }
+    case FUNCTION: {
+        // the program a function points into must outlive it
+        return new object::flat_function(&p, n, scope, &p.function_string(n));
+    }
+    case CALL: {
+        object::object* fn = eval(p, s.a, scope);
+        if(evaluator::is_error(fn)) {
+            return fn;
+        }
+        evaluator::value_stack& stack = evaluator::value_stack::local();
+        std::size_t mark = stack.size();
+        for(std::uint32_t i = 0; i < s.c; i++) {
+            object::object* evaluated = eval(p, p.list(s.b + i), scope);
+            if(evaluator::is_error(evaluated)) {
+                stack.pop_to(mark);
+                return evaluated;
+            }
+            if(!stack.push(evaluated)) {
+                stack.pop_to(mark);
+                return object::error::of(object::STACK_OVERFLOW_ERR, object::NULL_OBJ);
+            }
+        }
+        object::object* res = apply_function(fn, stack.since(mark));
+        stack.pop_to(mark);
+        return res;
+    }
+    case ARRAY: {
+        std::vector<object::object*> elements;
+        for(std::uint32_t i = 0; i < s.b; i++) {
+            object::object* evaluated = eval(p, p.list(s.a + i), scope);
+            if(evaluator::is_error(evaluated)) {
+                return evaluated;
+            }
+            elements.push_back(evaluated);
+        }
+        return evaluator::new_array(std::move(elements));
+    }
+    case INDEX: {
+        object::object* left = eval(p, s.a, scope);
+        if(evaluator::is_error(left)) {
+            return left;
+        }
+        object::object* index = eval(p, s.b, scope);
+        if(evaluator::is_error(index)) {
+            return index;
+        }
+        return evaluator::eval_index_expression(left, index);
+    }
+    case WHILE:
+        for(;;) {
+            object::object* condition = eval(p, s.a, scope);
+            if(evaluator::is_error(condition)) {
+                return condition;
+            }
+            if(!evaluator::is_truthy(condition)) {
+                return evaluator::NULL_O;
+            }
+            object::object* result = eval(p, s.b, scope);
+            if(result != nullptr && result->abrupt()) {
+                return result;
+            }
+        }
+    case FOR: {
+        object::object* iterable = eval(p, s.b, scope);
+        if(evaluator::is_error(iterable)) {
+            return iterable;
+        }
+        if(!evaluator::iterable(iterable)) {
+            return object::error::of(object::FOR_IN_ERR, iterable->type());
+        }
+        std::string name(p.symbol_name(s.a));
+        object::object* result = evaluator::drain(iterable, [&](object::object* x) -> object::object* {
+            scope->set(name, x);
+            object::object* res = eval(p, s.c, scope);
+            return res != nullptr && res->abrupt() ? res : nullptr;
+        });
+        return result != nullptr ? result : evaluator::NULL_O;
+    }
+    case ASSIGN: {
+        const operands& target = p.slots(s.a);
+        if(p.kind(s.a) == IDENT) {
+            object::object* val = eval(p, s.b, scope);
+            if(evaluator::is_error(val)) {
+                return val;
+            }
+            std::string_view name = p.symbol_name(target.a);
+            if(scope->assign(std::string(name), val) == nullptr) {
+                return new object::error(object::IDENTIFIER_ERR, name);
+            }
+            return val;
+        }
+        if(p.kind(s.a) != INDEX) {
+            std::string buf;
+            p.write(s.a, buf);
+            return new object::error(object::ASSIGN_TARGET_ERR, buf);
+        }
+        object::object* left = eval(p, target.a, scope);
+        if(evaluator::is_error(left)) {
+            return left;
+        }
+        object::object* index = eval(p, target.b, scope);
+        if(evaluator::is_error(index)) {
+            return index;
+        }
+        return evaluator::assign_element(left, index, [&] { return eval(p, s.b, scope); });
+    }
+    case SLICE: {
+        object::object* operands[3] = {};
+        node_id ids[3] = {s.a, s.b, s.c};
+        for(int i = 0; i < 3; i++) {
+            operands[i] = eval(p, ids[i], scope);
+            if(evaluator::is_error(operands[i])) {
+                return operands[i];
+            }
+        }
+        return evaluator::slice(operands[0], operands[1], operands[2]);
+    }
+    case HASH: {
+        object::hash_map* hash = new object::hash_map();
+        hash->reserve(s.b);
+        for(std::uint32_t i = 0; i < s.b; i++) {
+            object::object* key = eval(p, p.list(s.a + 2 * i), scope);
+            if(evaluator::is_error(key)) {
+                return key;
+            }
+            if(!object::hash_map::hashable(key)) {
+                return object::error::of(object::HASH_KEY_ERR, key->type());
+            }
+            object::object* value = eval(p, p.list(s.a + 2 * i + 1), scope);
+            if(evaluator::is_error(value)) {
+                return value;
+            }
+            hash->set(key, value);
+        }
+        return hash;
+    }
+    }
+    return nullptr;
+}
+
+inline object::object* eval(const program& p, object::scope* scope) { return eval(p, p.root(), scope); }
+
+} // namespace flat
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "ast.hpp"
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ast {
+
+/**
+ * Collects the names a function literal reads from its enclosing scopes, every
+ * identifier in the body that is not a parameter of the literal, or of a nested
+ * literal around it, and is not bound by a let or for-in in the same function.
+ * A name the function itself reads before its let or for-in binds it stays
+ * free, the frame resolves it from the captures until the binding exists.
+ */
+class free_variables : public child_visitor {
+public:
+    /**
+     * Free variables of fn in order of first use. The names fn binds with let at
+     * its own level, outside nested literals, are appended to locals.
+     */
+    static std::vector<std::string> of(const function_literal& fn, std::vector<std::string>* locals = nullptr) noexcept {
+        free_variables v;
+        v._locals = locals;
+        // the walk only reads, child_visitor hands out mutable references
+        v.enter(const_cast<function_literal&>(fn));
+        return std::move(v._names);
+    }
+
+    void visit(std::shared_ptr<statement>& child) noexcept override { walk(child); }
+    void visit(std::shared_ptr<expression>& child) noexcept override { walk(child); }
+    void visit(std::shared_ptr<block_statement>& child) noexcept override { walk(child); }
+
+private:
+    void enter(function_literal& fn) noexcept {
+        std::size_t depth = _bound.size();
+        std::size_t first = _names.size();
+        for(const auto& param : fn.parameters()) {
+            _bound.push_back(param->value());
+        }
+        _lets.emplace_back();
+        _early.emplace_back();
+        fn.visit_children(*this);
+
+        // nested literals run later, by then a let binds its name for the whole function
+        const std::vector<std::string_view>& lets = _lets.back();
+        const std::vector<std::string_view>& early = _early.back();
+        _names.erase(std::remove_if(_names.begin() + first, _names.end(), [&](const std::string& name) {
+            return std::find(lets.begin(), lets.end(), name) != lets.end()
+                && std::find(early.begin(), early.end(), name) == early.end();
+        }), _names.end());
+        if(_lets.size() == 1 && _locals != nullptr) {
+            for(std::string_view name : lets) {
+                if(std::find(_locals->begin(), _locals->end(), name) == _locals->end()) {
+                    _locals->emplace_back(name);
+                }
+            }
+        }
+        _early.pop_back();
+        _lets.pop_back();
+        _bound.resize(depth);
+    }
+
+    template <typename T>
+    void walk(std::shared_ptr<T>& n) noexcept {
+        if(n == nullptr) {
+            return;
+        }
+        if(auto ident = dynamic_cast<const identifier*>(n.get())) {
+            std::string_view name = ident->value();
+            if(std::find(_bound.begin(), _bound.end(), name) != _bound.end()) {
+                return;
+            }
+            if(std::find(_names.begin(), _names.end(), name) == _names.end()) {
+                _names.emplace_back(name);
+            }
+            const std::vector<std::string_view>& lets = _lets.back();
+            if(std::find(lets.begin(), lets.end(), name) == lets.end()) {
+                _early.back().push_back(name);
+            }
+            return;
+        }
+        // a binding starts after its value or iterable is evaluated
+        if(auto let = dynamic_cast<const let_statement*>(n.get())) {
+            n->visit_children(*this);
+            _lets.back().push_back(let->ident().value());
+            return;
+        }
+        if(auto loop = dynamic_cast<const for_statement*>(n.get())) {
+            auto iterable = std::const_pointer_cast<expression>(loop->iterable());
+            auto body = std::const_pointer_cast<block_statement>(loop->body());
+            walk(iterable);
+            _lets.back().push_back(loop->ident().value());
+            walk(body);
+            return;
+        }
+        if(auto fn = dynamic_cast<function_literal*>(n.get())) {
+            enter(*fn);
+            return;
+        }
+        n->visit_children(*this);
+    }
+
+    std::vector<std::string_view>                   _bound;
+    std::vector<std::vector<std::string_view>>      _lets;
+    std::vector<std::vector<std::string_view>>      _early;     // names read at the level before it binds them
+    std::vector<std::string>                        _names;
+    std::vector<std::string>*                       _locals = nullptr;
+};
+
+} // namespace ast
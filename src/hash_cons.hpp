@@ -0,0 +1,224 @@
+#pragma once
+
+#include "ast.hpp"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ast {
+
+/**
+ * Post-parse pass that deduplicates structurally identical subtrees into shared
+ * nodes. Children are canonicalized before their parent, so two nodes are
+ * identical exactly when their kind and payload match and their children have
+ * the same canonical node. A shared node keeps the span of its first occurrence.
+ *
+ * Only immutable subtrees are shared: literals, identifiers, prefix and infix
+ * expressions over them, and whole function literals. Statements, calls and
+ * the other node kinds get a canonical node for comparing their parents but
+ * are never replaced, so a later pass that rewrites one of them in place only
+ * changes that occurrence.
+ */
+class hash_consing : public child_visitor {
+public:
+    struct report {
+        std::size_t nodes = 0;          // nodes visited
+        std::size_t shared = 0;         // nodes replaced by an identical, earlier node
+        std::size_t bytes_saved = 0;    // estimated bytes released by the replaced subtrees
+    };
+
+    report run(program& p) noexcept {
+        _report = report();
+        _table.clear();
+        _canonical.clear();
+        _info.clear();
+        p.visit_children(*this);
+        return _report;
+    }
+
+    void visit(std::shared_ptr<statement>& child) noexcept override { canonicalize(child); }
+    void visit(std::shared_ptr<expression>& child) noexcept override { canonicalize(child); }
+    void visit(std::shared_ptr<block_statement>& child) noexcept override { canonicalize(child); }
+
+private:
+    /**
+     * Everything that identifies a node once its children are canonical.
+     */
+    struct shape {
+        std::uint8_t                kind = 0;
+        std::int64_t                number = 0;
+        std::string                 text{};
+        std::vector<const node*>    children{};
+        std::size_t                 bytes = 0; // footprint of the node itself, not part of its identity
+
+        bool operator==(const shape& other) const noexcept {
+            return kind == other.kind && number == other.number && text == other.text && children == other.children;
+        }
+    };
+
+    struct shape_hash {
+        std::size_t operator()(const shape& s) const noexcept {
+            std::size_t h = std::hash<std::string>()(s.text) ^ (s.kind * 0x9e3779b97f4a7c15ULL);
+            h = h * 31 + std::hash<std::int64_t>()(s.number);
+            for(const node* c : s.children) {
+                h = h * 31 + std::hash<const node*>()(c);
+            }
+            return h;
+        }
+    };
+
+    // control block and allocator overhead of a node held by std::shared_ptr
+    static constexpr std::size_t node_overhead = 2 * sizeof(void*) + 2 * sizeof(long);
+
+    /**
+     * What is known about a canonical node.
+     */
+    struct info {
+        bool            pure;   // immutable subtree that may be shared
+        std::size_t     owned;  // bytes dropping the node releases, its own and those of children only it holds
+    };
+
+    /**
+     * Literals and identifiers are pure, operator expressions are if their
+     * operands are, a function literal is as a whole, it runs nothing when evaluated.
+     */
+    bool pure(const node* n, const shape& s) const noexcept {
+        if(dynamic_cast<const function_literal*>(n)) {
+            return true;
+        }
+        if(dynamic_cast<const prefix_expression*>(n) || dynamic_cast<const infix_expression*>(n)) {
+            for(const node* c : s.children) {
+                auto child = _info.find(c);
+                if(child == _info.end() || !child->second.pure) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        return dynamic_cast<const identifier*>(n) || dynamic_cast<const int_literal*>(n) 
+            || dynamic_cast<const boolean*>(n) || dynamic_cast<const string_literal*>(n);
+    }
+
+    template <typename T>
+    void canonicalize(std::shared_ptr<T>& n) noexcept {
+        if(n == nullptr) {
+            return;
+        }
+        n->visit_children(*this);
+        ++_report.nodes;
+
+        shape s = shape_of(n.get());
+        auto it = _table.find(s);
+        if(it == _table.end()) {
+            info i{.pure = pure(n.get(), s), .owned = s.bytes + node_overhead};
+            for(const node* c : s.children) {
+                auto child = _info.find(c);
+                if(child != _info.end() && !child->second.pure) {
+                    i.owned += child->second.owned;
+                }
+            }
+            _canonical[n.get()] = n.get();
+            _info[n.get()] = i;
+            _table.emplace(std::move(s), n);
+            return;
+        }
+        _canonical[n.get()] = it->second.get();
+        const info& i = _info[it->second.get()];
+        if(it->second == n || !i.pure) {
+            return;
+        }
+        ++_report.shared;
+        _report.bytes_saved += i.owned;
+        n = std::static_pointer_cast<T>(it->second);
+    }
+
+    const node* canonical(const node* n) const noexcept {
+        auto it = _canonical.find(n);
+        return it != _canonical.end() ? it->second : n;
+    }
+
+    template <typename T>
+    std::vector<const node*> pointers(const std::vector<std::shared_ptr<T>>& nodes) const noexcept {
+        std::vector<const node*> res;
+        for(const auto& n : nodes) {
+            res.push_back(canonical(n.get()));
+        }
+        return res;
+    }
+
+    shape shape_of(const node* node) const noexcept {
+        if(auto n = dynamic_cast<const identifier*>(node)) {
+            return {.kind = 1, .text = std::string(n->value()), .bytes = sizeof(identifier) + n->value().size()};
+        }
+        if(auto n = dynamic_cast<const int_literal*>(node)) {
+            return {.kind = 2, .number = n->value(), .bytes = sizeof(int_literal)};
+        }
+        if(auto n = dynamic_cast<const boolean*>(node)) {
+            return {.kind = 3, .number = n->value(), .bytes = sizeof(boolean)};
+        }
+        if(auto n = dynamic_cast<const string_literal*>(node)) {
+            return {.kind = 4, .text = n->value(), .bytes = sizeof(string_literal) + n->value().capacity()};
+        }
+        if(auto n = dynamic_cast<const prefix_expression*>(node)) {
+            return {.kind = 5, .text = std::string(n->op()), .children = {canonical(n->expr().get())}, 
+                .bytes = sizeof(prefix_expression)};
+        }
+        if(auto n = dynamic_cast<const infix_expression*>(node)) {
+            return {.kind = 6, .text = std::string(n->op()), 
+                .children = {canonical(n->l_expr().get()), canonical(n->r_expr().get())}, .bytes = sizeof(infix_expression)};
+        }
+        if(auto n = dynamic_cast<const index_expression*>(node)) {
+            return {.kind = 7, .children = {canonical(n->left().get()), canonical(n->index().get())}, 
+                .bytes = sizeof(index_expression)};
+        }
+        if(auto n = dynamic_cast<const array_literal*>(node)) {
+            return {.kind = 8, .children = pointers(n->elements()), 
+                .bytes = sizeof(array_literal) + n->elements().capacity() * sizeof(std::shared_ptr<expression>)};
+        }
+        if(auto n = dynamic_cast<const call_expression*>(node)) {
+            shape s{.kind = 9, .children = pointers(n->arguments()), 
+                .bytes = sizeof(call_expression) + n->arguments().capacity() * sizeof(std::shared_ptr<expression>)};
+            s.children.push_back(canonical(n->function().get()));
+            return s;
+        }
+        if(auto n = dynamic_cast<const if_expression*>(node)) {
+            return {.kind = 10, .children = {canonical(n->condition().get()), canonical(n->consequence().get()), 
+                canonical(n->alternative().get())}, .bytes = sizeof(if_expression)};
+        }
+        if(auto n = dynamic_cast<const function_literal*>(node)) {
+            shape s{.kind = 11, .children = {canonical(n->body().get())}, .bytes = sizeof(function_literal)};
+            for(const auto& param : n->parameters()) {
+                s.text += param->value();
+                s.text += ',';
+                s.bytes += sizeof(identifier) + param->value().size() + node_overhead;
+            }
+            return s;
+        }
+        if(auto n = dynamic_cast<const block_statement*>(node)) {
+            return {.kind = 12, .children = pointers(n->statements()), 
+                .bytes = sizeof(block_statement) + n->statements().capacity() * sizeof(std::shared_ptr<statement>)};
+        }
+        if(auto n = dynamic_cast<const expression_statement*>(node)) {
+            return {.kind = 13, .children = {canonical(n->expr().get())}, .bytes = sizeof(expression_statement)};
+        }
+        if(auto n = dynamic_cast<const return_statement*>(node)) {
+            return {.kind = 14, .children = {canonical(n->return_value().get())}, .bytes = sizeof(return_statement)};
+        }
+        if(auto n = dynamic_cast<const let_statement*>(node)) {
+            return {.kind = 15, .text = std::string(n->ident().value()), .children = {canonical(n->value().get())}, 
+                .bytes = sizeof(let_statement) + n->ident().value().size()};
+        }
+        // unknown node kinds are only ever identical to themselves
+        return {.kind = 0, .children = {node}};
+    }
+
+    report                                                          _report;
+    std::unordered_map<shape, std::shared_ptr<node>, shape_hash>    _table;
+    std::unordered_map<const node*, const node*>                    _canonical;     // node to the first node identical to it
+    std::unordered_map<const node*, info>                           _info;          // keyed by canonical node
+};
+
+} // namespace ast
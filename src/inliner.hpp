@@ -0,0 +1,342 @@
+#pragma once
+
+#include "ast.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ast {
+
+/**
+ * Post-parse pass that replaces calls to small helper functions with their body.
+ * A helper is a function literal bound by a top-level let whose body is a single
+ * expression, optionally returned, built only from parameters, literals,
+ * operators, calls, indexing, arrays and if expressions over expression
+ * statements. Its name must be bound exactly once in the whole program. Every
+ * other name it reads must be bound exactly once, by a top-level let before the
+ * helper, or never bound at all, as builtins are, so the body means the same
+ * thing at every call site. A helper that reads its own name is recursive and
+ * never inlined.
+ *
+ * A call is inlined when it follows the let of the helper in program order and
+ * all its arguments are literals or names bound exactly once, by an earlier
+ * top-level let. Such arguments evaluate to the same value without side
+ * effects wherever, and however often, they are substituted for the
+ * parameters. Substituted bodies are not inlined into again.
+ */
+class inliner : public child_visitor {
+public:
+    struct report {
+        std::size_t candidates = 0;         // helpers small enough to inline
+        std::size_t inlined = 0;            // call sites replaced by a body
+        std::size_t skipped = 0;            // calls to a helper with arguments that are not constant
+        std::vector<std::string> functions; // helpers inlined at least once
+    };
+
+    /**
+     * @param budget the largest helper body, in nodes, that is inlined
+     */
+    inliner(std::size_t budget = 32) noexcept : _budget(budget) {}
+
+    report run(program& p) noexcept {
+        _report = report();
+        _helpers.clear();
+        _active.clear();
+
+        _census = binding_census();
+        p.visit_children(_census);
+        for(std::size_t i = 0; i < p.statements().size(); i++) {
+            if(auto let = dynamic_cast<const let_statement*>(p.statements()[i].get())) {
+                _census.bindings[std::string(let->ident().value())].top_level = i;
+            }
+        }
+        find_helpers(p);
+        _report.candidates = _helpers.size();
+
+        for(_statement = 0; _statement < p.statements().size(); _statement++) {
+            // statements are walked in place, the vector itself is not modified
+            auto& s = const_cast<std::shared_ptr<statement>&>(p.statements()[_statement]);
+            visit(s);
+            if(auto let = dynamic_cast<const let_statement*>(s.get())) {
+                auto it = _helpers.find(std::string(let->ident().value()));
+                if(it != _helpers.end() && it->second.let == let) {
+                    _active.emplace(it->first, &it->second);
+                }
+            }
+        }
+        return _report;
+    }
+
+    void visit(std::shared_ptr<statement>& child) noexcept override { if(child != nullptr) { child->visit_children(*this); } }
+    void visit(std::shared_ptr<block_statement>& child) noexcept override { if(child != nullptr) { child->visit_children(*this); } }
+    void visit(std::shared_ptr<expression>& child) noexcept override {
+        if(child == nullptr) {
+            return;
+        }
+        child->visit_children(*this);
+        if(auto call = dynamic_cast<const call_expression*>(child.get())) {
+            inline_call(child, *call);
+        }
+    }
+
+private:
+    struct helper {
+        const let_statement*                        let;
+        const function_literal*                     fn;
+        std::shared_ptr<expression>                 body;
+        bool                                        used = false;
+    };
+
+    /**
+     * How often a name is bound, by any let, for-in, parameter or assignment in
+     * the program, and the index of the top-level let statement binding it, if
+     * any.
+     */
+    struct binding {
+        std::size_t count = 0;
+        std::size_t top_level = NOT_TOP_LEVEL;
+    };
+    static constexpr std::size_t NOT_TOP_LEVEL = SIZE_MAX;
+
+    struct binding_census : child_visitor {
+        std::unordered_map<std::string, binding>        bindings;
+
+        void visit(std::shared_ptr<statement>& child) noexcept override {
+            if(child == nullptr) {
+                return;
+            }
+            if(auto let = dynamic_cast<const let_statement*>(child.get())) {
+                ++bindings[std::string(let->ident().value())].count;
+            } else if(auto loop = dynamic_cast<const for_statement*>(child.get())) {
+                ++bindings[std::string(loop->ident().value())].count;
+            }
+            child->visit_children(*this);
+        }
+        void visit(std::shared_ptr<expression>& child) noexcept override {
+            if(child == nullptr) {
+                return;
+            }
+            if(auto fn = dynamic_cast<const function_literal*>(child.get())) {
+                for(const auto& param : fn->parameters()) {
+                    ++bindings[std::string(param->value())].count;
+                }
+            } else if(auto assign = dynamic_cast<const assign_expression*>(child.get())) {
+                if(auto target = dynamic_cast<const identifier*>(assign->target().get())) {
+                    ++bindings[std::string(target->value())].count;
+                }
+            }
+            child->visit_children(*this);
+        }
+        void visit(std::shared_ptr<block_statement>& child) noexcept override { if(child != nullptr) { child->visit_children(*this); } }
+    };
+
+    /**
+     * Replaces parameters with arguments in a copy of a helper body. Subtrees
+     * without parameters are shared with the helper rather than copied.
+     */
+    struct substitution : child_visitor {
+        const std::vector<std::shared_ptr<identifier>>&     params;
+        const std::vector<std::shared_ptr<expression>>&     args;
+
+        substitution(const std::vector<std::shared_ptr<identifier>>& p, const std::vector<std::shared_ptr<expression>>& a)
+            noexcept : params(p), args(a) {}
+
+        void visit(std::shared_ptr<statement>& child) noexcept override {
+            if(auto n = dynamic_cast<const expression_statement*>(child.get())) {
+                child = std::make_shared<expression_statement>(*n);
+                child->visit_children(*this);
+            }
+        }
+        void visit(std::shared_ptr<block_statement>& child) noexcept override {
+            if(child != nullptr) {
+                child = std::make_shared<block_statement>(*child);
+                child->visit_children(*this);
+            }
+        }
+        void visit(std::shared_ptr<expression>& child) noexcept override {
+            if(auto ident = dynamic_cast<const identifier*>(child.get())) {
+                for(std::size_t i = 0; i < params.size(); i++) {
+                    if(params[i]->value() == ident->value()) {
+                        child = args[i];
+                        return;
+                    }
+                }
+                return;
+            }
+            if(auto n = dynamic_cast<const prefix_expression*>(child.get())) {
+                child = std::make_shared<prefix_expression>(*n);
+            } else if(auto n = dynamic_cast<const infix_expression*>(child.get())) {
+                child = std::make_shared<infix_expression>(*n);
+            } else if(auto n = dynamic_cast<const call_expression*>(child.get())) {
+                child = std::make_shared<call_expression>(*n);
+            } else if(auto n = dynamic_cast<const index_expression*>(child.get())) {
+                child = std::make_shared<index_expression>(*n);
+            } else if(auto n = dynamic_cast<const array_literal*>(child.get())) {
+                child = std::make_shared<array_literal>(*n);
+            } else if(auto n = dynamic_cast<const if_expression*>(child.get())) {
+                child = std::make_shared<if_expression>(*n);
+            } else {
+                return; // literals are shared
+            }
+            child->visit_children(*this);
+        }
+    };
+
+    void find_helpers(program& p) noexcept {
+        for(std::size_t i = 0; i < p.statements().size(); i++) {
+            auto let = dynamic_cast<const let_statement*>(p.statements()[i].get());
+            if(let == nullptr) {
+                continue;
+            }
+            auto fn = std::dynamic_pointer_cast<const function_literal>(let->value());
+            if(fn == nullptr || fn->body() == nullptr || fn->body()->statements().size() != 1) {
+                continue;
+            }
+            std::shared_ptr<expression> body;
+            const statement* only = fn->body()->statements()[0].get();
+            if(auto es = dynamic_cast<const expression_statement*>(only)) {
+                body = std::const_pointer_cast<expression>(es->expr());
+            } else if(auto rs = dynamic_cast<const return_statement*>(only)) {
+                body = std::const_pointer_cast<expression>(rs->return_value());
+            }
+            std::string name(let->ident().value());
+            std::size_t size = 0;
+            if(body == nullptr || bound(name).count != 1 || !inlinable(*body, name, i, *fn, size)) {
+                continue;
+            }
+            _helpers.emplace(name, helper{let, fn.get(), body});
+        }
+    }
+
+    binding bound(const std::string& name) const noexcept {
+        auto it = _census.bindings.find(name);
+        return it != _census.bindings.end() ? it->second : binding();
+    }
+
+    /**
+     * Whether name is bound exactly once, by a top-level let statement before
+     * the statement at index before, and so holds the same value from then on.
+     */
+    bool constant_before(const std::string& name, std::size_t before) const noexcept {
+        binding b = bound(name);
+        return b.count == 1 && b.top_level < before;
+    }
+
+    bool inlinable(const node& n, const std::string& self, std::size_t at, const function_literal& fn,
+            std::size_t& size) const noexcept {
+        if(++size > _budget) {
+            return false;
+        }
+        if(auto ident = dynamic_cast<const identifier*>(&n)) {
+            for(const auto& param : fn.parameters()) {
+                if(param->value() == ident->value()) {
+                    return true;
+                }
+            }
+            std::string name(ident->value());
+            // other names must mean the same thing wherever the body lands, a
+            // name bound nowhere is a builtin or fails the same way everywhere
+            return name != self && (constant_before(name, at) || bound(name).count == 0);
+        }
+        if(dynamic_cast<const int_literal*>(&n) || dynamic_cast<const boolean*>(&n) || dynamic_cast<const string_literal*>(&n)) {
+            return true;
+        }
+        if(auto e = dynamic_cast<const prefix_expression*>(&n)) {
+            return inlinable(*e->expr(), self, at, fn, size);
+        }
+        if(auto e = dynamic_cast<const infix_expression*>(&n)) {
+            return inlinable(*e->l_expr(), self, at, fn, size) && inlinable(*e->r_expr(), self, at, fn, size);
+        }
+        if(auto e = dynamic_cast<const index_expression*>(&n)) {
+            return inlinable(*e->left(), self, at, fn, size) && inlinable(*e->index(), self, at, fn, size);
+        }
+        if(auto e = dynamic_cast<const call_expression*>(&n)) {
+            for(const auto& arg : e->arguments()) {
+                if(!inlinable(*arg, self, at, fn, size)) {
+                    return false;
+                }
+            }
+            return inlinable(*e->function(), self, at, fn, size);
+        }
+        if(auto e = dynamic_cast<const array_literal*>(&n)) {
+            for(const auto& element : e->elements()) {
+                if(!inlinable(*element, self, at, fn, size)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        if(auto e = dynamic_cast<const if_expression*>(&n)) {
+            if(!inlinable(*e->condition(), self, at, fn, size)) {
+                return false;
+            }
+            for(const auto& block : {e->consequence(), e->alternative()}) {
+                if(block == nullptr) {
+                    continue;
+                }
+                for(const auto& stmt : block->statements()) {
+                    // a return would leave the caller once inlined
+                    auto es = dynamic_cast<const expression_statement*>(stmt.get());
+                    if(es == nullptr || es->expr() == nullptr || !inlinable(*es->expr(), self, at, fn, size)) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Whether arg may be evaluated any number of times, including none, in
+     * place of a parameter without changing what the program does.
+     */
+    bool constant(const expression& arg) const noexcept {
+        if(auto ident = dynamic_cast<const identifier*>(&arg)) {
+            return constant_before(std::string(ident->value()), _statement);
+        }
+        return dynamic_cast<const int_literal*>(&arg) || dynamic_cast<const boolean*>(&arg)
+            || dynamic_cast<const string_literal*>(&arg);
+    }
+
+    void inline_call(std::shared_ptr<expression>& site, const call_expression& call) noexcept {
+        auto callee = dynamic_cast<const identifier*>(call.function().get());
+        if(callee == nullptr) {
+            return;
+        }
+        auto it = _active.find(callee->value());
+        if(it == _active.end()) {
+            return;
+        }
+        helper& h = *it->second;
+        if(call.arguments().size() != h.fn->parameters().size()) {
+            return;
+        }
+        for(const auto& arg : call.arguments()) {
+            if(!constant(*arg)) {
+                ++_report.skipped;
+                return;
+            }
+        }
+        if(!h.used) {
+            h.used = true;
+            _report.functions.push_back(std::string(callee->value()));
+        }
+        ++_report.inlined;
+        std::shared_ptr<expression> body = h.body;
+        substitution(h.fn->parameters(), call.arguments()).visit(body);
+        site = body; // releases the call, callee and call are dangling from here on
+    }
+
+    std::size_t                                             _budget;
+    report                                                  _report;
+    binding_census                                          _census;
+    std::size_t                                             _statement = 0;
+    std::unordered_map<std::string, helper>                 _helpers;
+    std::unordered_map<std::string_view, helper*>           _active;
+};
+
+} // namespace ast
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define KERNELS_AVX2 1
+#endif
+
+/**
+ * Reductions and element-wise operators over unboxed integer arrays. Each
+ * kernel has a scalar version and, on x86-64, an AVX2 version that handles 4
+ * elements per step and is picked at run time if the CPU supports it, so the
+ * build needs no -mavx2. Sums and products wrap around on overflow, and so
+ * does INT64_MIN / -1.
+ */
+namespace kernels {
+
+/**
+ * Element-wise operators, comparisons yield 1 or 0.
+ */
+enum class op : std::uint8_t { add, sub, mul, div, lt, gt, eq, ne };
+
+namespace scalar {
+
+inline std::int64_t sum(std::span<const std::int64_t> v) noexcept {
+    std::uint64_t res = 0;
+    for(std::int64_t x : v) {
+        res += static_cast<std::uint64_t>(x);
+    }
+    return static_cast<std::int64_t>(res);
+}
+
+inline std::int64_t min(std::span<const std::int64_t> v) noexcept { return *std::min_element(v.begin(), v.end()); }
+inline std::int64_t max(std::span<const std::int64_t> v) noexcept { return *std::max_element(v.begin(), v.end()); }
+
+template <bool Max>
+inline std::int64_t extreme(std::span<const std::int64_t> v) noexcept { return Max ? max(v) : min(v); }
+
+inline std::int64_t dot(std::span<const std::int64_t> a, std::span<const std::int64_t> b) noexcept {
+    std::uint64_t res = 0;
+    for(std::size_t i = 0; i < a.size(); i++) {
+        res += static_cast<std::uint64_t>(a[i]) * static_cast<std::uint64_t>(b[i]);
+    }
+    return static_cast<std::int64_t>(res);
+}
+
+inline std::size_t count(std::span<const std::int64_t> v, std::int64_t x) noexcept { return std::count(v.begin(), v.end(), x); }
+
+inline std::int64_t apply(op o, std::int64_t a, std::int64_t b) noexcept {
+    switch(o) {
+    case op::add:   return static_cast<std::int64_t>(static_cast<std::uint64_t>(a) + static_cast<std::uint64_t>(b));
+    case op::sub:   return static_cast<std::int64_t>(static_cast<std::uint64_t>(a) - static_cast<std::uint64_t>(b));
+    case op::mul:   return static_cast<std::int64_t>(static_cast<std::uint64_t>(a) * static_cast<std::uint64_t>(b));
+    case op::div:   return b == -1 ? static_cast<std::int64_t>(0 - static_cast<std::uint64_t>(a)) : a / b;
+    case op::lt:    return a < b;
+    case op::gt:    return a > b;
+    case op::eq:    return a == b;
+    case op::ne:    return a != b;
+    }
+    return 0;
+}
+
+/**
+ * out[i] = a[i] o b[i], starting at from. An operand of size 1 is broadcast.
+ */
+inline void elementwise(op o, std::span<const std::int64_t> a, std::span<const std::int64_t> b, std::span<std::int64_t> out, 
+        std::size_t from = 0) noexcept {
+    bool sa = a.size() == 1, sb = b.size() == 1;
+    for(std::size_t i = from; i < out.size(); i++) {
+        out[i] = apply(o, a[sa ? 0 : i], b[sb ? 0 : i]);
+    }
+}
+
+} // namespace scalar
+
+#if defined(KERNELS_AVX2)
+namespace avx2 {
+
+__attribute__((target("avx2"))) inline __m256i load(const std::int64_t* p) noexcept {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+__attribute__((target("avx2"))) inline std::int64_t lane(__m256i v, int i) noexcept {
+    alignas(32) std::int64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), v);
+    return lanes[i];
+}
+
+__attribute__((target("avx2"))) inline std::int64_t sum(std::span<const std::int64_t> v) noexcept {
+    __m256i acc = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for(; i + 4 <= v.size(); i += 4) {
+        acc = _mm256_add_epi64(acc, load(v.data() + i));
+    }
+    std::uint64_t res = 0;
+    for(int k = 0; k < 4; k++) {
+        res += static_cast<std::uint64_t>(lane(acc, k));
+    }
+    return static_cast<std::int64_t>(res + static_cast<std::uint64_t>(scalar::sum(v.subspan(i))));
+}
+
+/**
+ * Smallest element if Max is false, largest otherwise. AVX2 has no 64-bit
+ * min or max, they are a compare and a blend.
+ */
+template <bool Max>
+__attribute__((target("avx2"))) inline std::int64_t extreme(std::span<const std::int64_t> v) noexcept {
+    if(v.size() < 4) {
+        return scalar::extreme<Max>(v);
+    }
+    __m256i acc = load(v.data());
+    std::size_t i = 4;
+    for(; i + 4 <= v.size(); i += 4) {
+        __m256i x = load(v.data() + i);
+        __m256i greater = _mm256_cmpgt_epi64(x, acc);
+        acc = Max ? _mm256_blendv_epi8(acc, x, greater) : _mm256_blendv_epi8(x, acc, greater);
+    }
+    std::int64_t res = lane(acc, 0);
+    for(int k = 1; k < 4; k++) {
+        res = Max ? std::max(res, lane(acc, k)) : std::min(res, lane(acc, k));
+    }
+    for(; i < v.size(); i++) {
+        res = Max ? std::max(res, v[i]) : std::min(res, v[i]);
+    }
+    return res;
+}
+
+/**
+ * Low 64 bits of a * b per lane, from 32-bit products since AVX2 has no 64-bit multiply.
+ */
+__attribute__((target("avx2"))) inline __m256i mul(__m256i a, __m256i b) noexcept {
+    __m256i lo = _mm256_mul_epu32(a, b);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b), _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+__attribute__((target("avx2"))) inline std::int64_t dot(std::span<const std::int64_t> a, std::span<const std::int64_t> b) noexcept {
+    __m256i acc = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for(; i + 4 <= a.size(); i += 4) {
+        acc = _mm256_add_epi64(acc, mul(load(a.data() + i), load(b.data() + i)));
+    }
+    std::uint64_t res = 0;
+    for(int k = 0; k < 4; k++) {
+        res += static_cast<std::uint64_t>(lane(acc, k));
+    }
+    return static_cast<std::int64_t>(res + static_cast<std::uint64_t>(scalar::dot(a.subspan(i), b.subspan(i))));
+}
+
+__attribute__((target("avx2"))) inline std::size_t count(std::span<const std::int64_t> v, std::int64_t x) noexcept {
+    __m256i needle = _mm256_set1_epi64x(x);
+    __m256i acc = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for(; i + 4 <= v.size(); i += 4) {
+        // a match is -1 in its lane
+        acc = _mm256_sub_epi64(acc, _mm256_cmpeq_epi64(load(v.data() + i), needle));
+    }
+    std::size_t res = 0;
+    for(int k = 0; k < 4; k++) {
+        res += static_cast<std::size_t>(lane(acc, k));
+    }
+    return res + scalar::count(v.subspan(i), x);
+}
+
+/**
+ * out = a o b for the operators AVX2 has, or can build, 64-bit lanes for.
+ */
+__attribute__((target("avx2"))) inline __m256i apply(op o, __m256i a, __m256i b) noexcept {
+    const __m256i one = _mm256_set1_epi64x(1);
+    switch(o) {
+    case op::add:   return _mm256_add_epi64(a, b);
+    case op::sub:   return _mm256_sub_epi64(a, b);
+    case op::mul:   return mul(a, b);
+    case op::lt:    return _mm256_and_si256(_mm256_cmpgt_epi64(b, a), one);
+    case op::gt:    return _mm256_and_si256(_mm256_cmpgt_epi64(a, b), one);
+    case op::eq:    return _mm256_and_si256(_mm256_cmpeq_epi64(a, b), one);
+    case op::ne:    return _mm256_andnot_si256(_mm256_cmpeq_epi64(a, b), one);
+    default:        return a;
+    }
+}
+
+__attribute__((target("avx2"))) inline void elementwise(op o, std::span<const std::int64_t> a, std::span<const std::int64_t> b, 
+        std::span<std::int64_t> out) noexcept {
+    if(o == op::div) {
+        // there is no integer division, not even by a constant
+        return scalar::elementwise(o, a, b, out);
+    }
+    bool sa = a.size() == 1, sb = b.size() == 1;
+    __m256i va = sa ? _mm256_set1_epi64x(a[0]) : _mm256_setzero_si256();
+    __m256i vb = sb ? _mm256_set1_epi64x(b[0]) : _mm256_setzero_si256();
+    std::size_t i = 0;
+    for(; i + 4 <= out.size(); i += 4) {
+        __m256i res = apply(o, sa ? va : load(a.data() + i), sb ? vb : load(b.data() + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out.data() + i), res);
+    }
+    scalar::elementwise(o, a, b, out, i);
+}
+
+} // namespace avx2
+#endif
+
+inline bool has_avx2() noexcept {
+#if defined(KERNELS_AVX2)
+    static const bool res = __builtin_cpu_supports("avx2");
+    return res;
+#else
+    return false;
+#endif
+}
+
+#if defined(KERNELS_AVX2)
+#define KERNELS_DISPATCH(fn, ...) (has_avx2() ? avx2::fn(__VA_ARGS__) : scalar::fn(__VA_ARGS__))
+#else
+#define KERNELS_DISPATCH(fn, ...) scalar::fn(__VA_ARGS__)
+#endif
+
+inline std::int64_t sum(std::span<const std::int64_t> v) noexcept { return KERNELS_DISPATCH(sum, v); }
+
+/**
+ * Smallest element, v must not be empty.
+ */
+inline std::int64_t min(std::span<const std::int64_t> v) noexcept { return KERNELS_DISPATCH(extreme<false>, v); }
+
+/**
+ * Largest element, v must not be empty.
+ */
+inline std::int64_t max(std::span<const std::int64_t> v) noexcept { return KERNELS_DISPATCH(extreme<true>, v); }
+
+/**
+ * Sum of the products of a[i] and b[i], a and b have the same size.
+ */
+inline std::int64_t dot(std::span<const std::int64_t> a, std::span<const std::int64_t> b) noexcept { return KERNELS_DISPATCH(dot, a, b); }
+
+/**
+ * Number of elements equal to x.
+ */
+inline std::size_t count(std::span<const std::int64_t> v, std::int64_t x) noexcept { return KERNELS_DISPATCH(count, v, x); }
+
+/**
+ * out[i] = a[i] o b[i], where a or b may have size 1 and is then broadcast, 
+ * out has the size of the other. Division by zero is undefined.
+ */
+inline void elementwise(op o, std::span<const std::int64_t> a, std::span<const std::int64_t> b, std::span<std::int64_t> out) noexcept { 
+    KERNELS_DISPATCH(elementwise, o, a, b, out); 
+}
+
+#undef KERNELS_DISPATCH
+
+} // namespace kernels
@@ -1,13 +1,96 @@
 #pragma once
 
+#include <algorithm>
 #include <cctype>
 #include <cstdint>
 #include <cstring>
 #include <string_view>
+#include <vector>
 #include "token.hpp"
 
 namespace lexer {
 
+/**
+ * Structure-of-arrays token stream: token types, start offsets and lengths are
+ * kept in parallel arrays indexed by token position. Literals are views into 
+ * the source, so the source must outlive the buffer.
+ */
+class token_buffer {
+public:
+    token_buffer() noexcept = default;
+    token_buffer(const char* source) noexcept : _source(source) {}
+
+    void reserve(std::size_t n) {
+        _types.reserve(n);
+        _offsets.reserve(n);
+        _lengths.reserve(n);
+    }
+
+    void push(token::token_t type, std::uint32_t offset, std::uint32_t length) {
+        _types.push_back(type);
+        _offsets.push_back(offset);
+        _lengths.push_back(length);
+    }
+
+    std::size_t size() const noexcept { return _types.size(); }
+    const char* source() const noexcept { return _source; }
+
+    token::token_t type(std::size_t i) const noexcept { return _types[i]; }
+    std::uint32_t offset(std::size_t i) const noexcept { return _offsets[i]; }
+    std::uint32_t length(std::size_t i) const noexcept { return _lengths[i]; }
+
+    std::string_view literal(std::size_t i) const noexcept { 
+        return std::string_view(_source + _offsets[i], _lengths[i]); 
+    }
+    token::span span(std::size_t i) const noexcept { return token::span{_offsets[i], _lengths[i]}; }
+
+private:
+    const char*                 _source = nullptr;
+    std::vector<token::token_t> _types;
+    std::vector<std::uint32_t>  _offsets;
+    std::vector<std::uint32_t>  _lengths;
+};
+
+/**
+ * Maps byte offsets in a source to 1-based line and column numbers. The table of
+ * line starts is only built on the first lookup, so keeping one around is free 
+ * until a location is actually needed.
+ */
+class line_table {
+public:
+    struct position {
+        std::uint32_t line;
+        std::uint32_t column;
+    };
+
+    line_table() = delete;
+    line_table(const char* source) : _source(source) {}
+
+    position locate(std::uint32_t offset) noexcept {
+        if(_line_starts.empty()) {
+            build();
+        }
+        auto it = std::upper_bound(_line_starts.begin(), _line_starts.end(), offset);
+        std::uint32_t line = it - _line_starts.begin();
+        return position{line, offset - _line_starts[line - 1] + 1};
+    }
+
+    position locate(const token::span& span) noexcept { return locate(span.offset); }
+
+private:
+    void build() {
+        _line_starts.push_back(0);
+        for(std::uint32_t i = 0; _source[i] != 0; i++) {
+            if(_source[i] == '\n') {
+                _line_starts.push_back(i + 1);
+            }
+        }
+    }
+
+    const char*                 _source;
+    std::vector<std::uint32_t>  _line_starts;
+};
+
 class lexer {
 public:
     lexer() = delete;
@@ -26,94 +109,111 @@ public:
     }
     
     token::token next_token() {
+        token::token_t type = scan();
+        return token::token(type, std::string_view(_input + _token_start, _token_len), token::span{_token_start, _token_len});
+    }
+
+    /**
+     * Lexes the whole input up front into a token_buffer, the buffer is reserved
+     * from a cheap estimate of the token count so that it rarely has to grow.
+     */
+    token_buffer tokenize() {
+        token_buffer buf(_input);
+        buf.reserve(estimate_token_count());
+
+        token::token_t type;
+        do {
+            type = scan();
+            buf.push(type, _token_start, _token_len);
+        } while(type != token::EOFT);
+
+        return buf;
+    }
+
+    /**
+     * Advances to the next token and returns its type, the position of its literal 
+     * within the input is left in _token_start and _token_len.
+     */
+    token::token_t scan() noexcept {
         read_char();
         if(std::isspace(_cur_char)) {
             skip_whitespace();
         }
 
-        token::token cur_token;
-        std::string_view cur_char(&_cur_char, 1);
+        _token_start = _cursor;
+        _token_len = 1;
 
         switch (_cur_char) {
         case '=':
             if(peek_char() == '='){
                 read_char();
-                cur_token.set(token::EQ, "==");
-            } else {
-                cur_token.set(token::ASSIGN, cur_char);
+                _token_len = 2;
+                return token::EQ;
             }
-            break;
+            return token::ASSIGN;
         case '+':
-            cur_token.set(token::PLUS, cur_char);
-            break;
+            return token::PLUS;
         case '-':
-            cur_token.set(token::MINUS, cur_char);
-            break;
+            return token::MINUS;
         case '*':
-            cur_token.set(token::ASTERISK, cur_char);
-            break;
+            return token::ASTERISK;
         case '/':
-            cur_token.set(token::SLASH, cur_char);
-            break;
+            return token::SLASH;
         case ',':
-            cur_token.set(token::COMMA, cur_char);
-            break;
+            return token::COMMA;
         case ';':
-            cur_token.set(token::SEMICOLON, cur_char);
-            break;
+            return token::SEMICOLON;
+        case ':':
+            return token::COLON;
         case '!':
             if(peek_char() == '='){
                 read_char();
-                cur_token.set(token::NEQ, "!=");
-            } else {
-                cur_token.set(token::BANG, cur_char);
+                _token_len = 2;
+                return token::NEQ;
             }
-            break;
+            return token::BANG;
         case '>':
-            cur_token.set(token::GT, cur_char);
-            break;
+            return token::GT;
         case '<':
-            cur_token.set(token::LT, cur_char);
-            break;
+            return token::LT;
         case '(':
-            cur_token.set(token::LPAREN, cur_char);
-            break;
+            return token::LPAREN;
         case ')':
-            cur_token.set(token::RPAREN, cur_char);
-            break;
+            return token::RPAREN;
         case '{':
-            cur_token.set(token::LBRACE, cur_char);
-            break;
+            return token::LBRACE;
         case '}':
-            cur_token.set(token::RBRACE, cur_char);
-            break;
+            return token::RBRACE;
         case '[':
-            cur_token.set(token::LBRACKET, cur_char);
-            break;
+            return token::LBRACKET;
         case ']':
-            cur_token.set(token::RBRACKET, cur_char);
-            break;
+            return token::RBRACKET;
         case '"':
-            cur_token.set(token::STRING, read_string());
-            break;
+            set_token_literal(read_string());
+            return token::STRING;
         case 0:
-            cur_token.set(token::EOFT, "");
-            break;
+            _token_start = _input_len;
+            _token_len = 0;
+            return token::EOFT;
         default: 
             if(is_letter(_cur_char)) {
                 std::string_view ident = read_identifier();
-                cur_token.set(lookup_ident(ident), ident);
+                set_token_literal(ident);
+                return lookup_ident(ident);
             }else if(std::isdigit(_cur_char)) {
-                std::string_view digits = read_digits();
-                cur_token.set(token::INT, digits);
-            }else{
-                cur_token.set(token::ILLEGAL, cur_char);
+                set_token_literal(read_digits());
+                return token::INT;
             }
+            return token::ILLEGAL;
         }
-        
-        return cur_token;
     }
 
+    /**
+     * Rough upper-bound guess of the token count, most tokens in typical 
+     * source are at least a few characters apart once whitespace is counted.
+     */
+    std::size_t estimate_token_count() const noexcept { return _input_len / 3 + 1; }
+
     std::string_view read_string() noexcept {
         std::uint32_t start = _cursor + 1;
         for(;;){
@@ -164,6 +264,11 @@ public:
         return digits;
     }
 
+    void set_token_literal(std::string_view literal) noexcept {
+        _token_start = literal.data() - _input;
+        _token_len = literal.size();
+    }
+
     token::token_t lookup_ident(std::string_view ident) noexcept {
         auto it = token::keywords.find(ident);
         if(it != token::keywords.end()){
@@ -178,6 +283,8 @@ private:
     std::uint32_t   _cursor;        // current position of the lexer
     std::uint32_t   _peek_cursor;   // current  look ahead position
     char            _cur_char;      // char pointed by _cursor 
+    std::uint32_t   _token_start;   // offset of the last scanned token's literal
+    std::uint32_t   _token_len;     // length of the last scanned token's literal
 };
 
 
@@ -1,31 +1,153 @@
 #pragma once
 
 #include "ast.hpp"
+#include "persistent_vector.hpp"
+#include "pool.hpp"
+#include "prototype.hpp"
+#include "swiss_table.hpp"
+#include "utf8.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <memory>
+#include <span>
 #include <string>
-#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace flat { class program; }
 
 namespace object {
 
-using object_t = const char*;
+using object_t = std::uint8_t;
+constexpr size_t object_count = 13;
+
+constexpr object_t INTEGER_OBJ          = 0;
+constexpr object_t BOOLEAN_OBJ          = 1;
+constexpr object_t NULL_OBJ             = 2;
+constexpr object_t RETURN_VALUE_OBJ     = 3;
+constexpr object_t ERROR_OBJ            = 4;
+constexpr object_t FUNCTION_OBJ         = 5;
+constexpr object_t STRING_OBJ           = 6;
+constexpr object_t BUILTIN_OBJ          = 7;
+constexpr object_t ARRAY_OBJ            = 8;
+constexpr object_t FLAT_FUNCTION_OBJ    = 9;
+constexpr object_t HASH_OBJ             = 10;
+constexpr object_t RANGE_OBJ            = 11;
+constexpr object_t SEQUENCE_OBJ         = 12;
+
+const std::array<std::string, object_count> inv_map {
+    "INTEGER", "BOOLEAN", "NULL", "RETURN_VALUE", "ERROR", 
+    "FUNCTION", "STRING", "BUILTIN", "ARRAY", "FUNCTION", "HASH", "RANGE", "SEQUENCE"
+};
 
-constexpr object_t INTEGER_OBJ      = "INTEGER";
-constexpr object_t BOOLEAN_OBJ      = "BOOLEAN";
-constexpr object_t NULL_OBJ         = "NULL";
-constexpr object_t RETURN_VALUE_OBJ = "RETURN_VALUE";
-constexpr object_t ERROR_OBJ        = "ERROR";
-constexpr object_t FUNCTION_OBJ     = "FUNCTION";
-constexpr object_t STRING_OBJ       = "STRING";
-constexpr object_t BUILTIN_OBJ      = "BUILTIN";
-constexpr object_t ARRAY_OBJ        = "ARRAY";
+using error_t = std::uint8_t;
 
+constexpr error_t CUSTOM_ERR            = 0;    // free-form message
+constexpr error_t TYPE_MISMATCH_ERR     = 1;    // type mismatch: L op R
+constexpr error_t UNKNOWN_OPERATOR_ERR  = 2;    // unknown operator: L op R
+constexpr error_t UNKNOWN_PREFIX_ERR    = 3;    // unknown operator: opR
+constexpr error_t INDEX_OPERATOR_ERR    = 4;    // index operator not supported: L R
+constexpr error_t INDEX_ASSIGNMENT_ERR  = 5;    // index assignment not supported: L R
+constexpr error_t FOR_IN_ERR            = 6;    // for-in not supported: R
+constexpr error_t NOT_A_FUNCTION_ERR    = 7;    // not a function: R
+constexpr error_t ARGUMENT_TYPE_ERR     = 8;    // argument to name not supported, got R
+constexpr error_t STACK_OVERFLOW_ERR    = 9;    // stack overflow
+constexpr error_t IDENTIFIER_ERR        = 10;   // identifier not found: name
+constexpr error_t ARGUMENT_COUNT_ERR    = 11;   // wrong number of arguments. got=N, want=M
+constexpr error_t INDEX_RANGE_ERR       = 12;   // index out of range: N
+constexpr error_t SLICE_OPERATOR_ERR    = 13;   // slice operator not supported: L R
+constexpr error_t HASH_KEY_ERR          = 14;   // unusable as hash key: R
+constexpr error_t LENGTH_MISMATCH_ERR   = 15;   // length mismatch: N and M
+constexpr error_t DIVISION_BY_ZERO_ERR  = 16;   // division by zero
+constexpr error_t ASSIGN_TARGET_ERR     = 17;   // cannot assign to target
+constexpr error_t RANGE_STEP_ERR        = 18;   // range step cannot be zero
 
+/**
+ * Compact header shared by all runtime objects: a 1-byte type tag, GC bits and a
+ * lazily cached hash, 8 bytes in total. There is no vtable, behaviour that 
+ * depends on the concrete type is dispatched with a switch on the tag, and
+ * as<T>() replaces dynamic_cast.
+ */
 struct object {
-    const virtual std::string& inspect() const noexcept = 0;
-    const virtual object_t& type() const noexcept = 0;
-    virtual ~object() noexcept = default; 
+    object(object_t type) noexcept : _type(type) {}
+
+    // objects are carved out of the thread's pool, deletes must name the concrete type (see destroy())
+    static void* operator new(std::size_t size) { return pool::local().allocate(size); }
+    static void operator delete(void* p, std::size_t size) noexcept { pool::local().deallocate(p, size); }
+
+    object_t type() const noexcept { return _type; }
+
+    std::uint8_t gc_bits() const noexcept { return _gc_bits; }
+    void set_gc_bits(std::uint8_t bits) noexcept { _gc_bits = bits; }
+
+    std::uint32_t hash() noexcept;
+
+    /**
+     * True for return values and errors, which end the statement list they are
+     * produced in. A single flag test on the hot path of every statement.
+     */
+    bool abrupt() const noexcept { return _flags & ABRUPT; }
+
+    std::string inspect() const noexcept;
+    void inspect(std::string& buf) const noexcept;
+
+protected:
+    static constexpr std::uint8_t HASH_CACHED = 1;
+    static constexpr std::uint8_t ABRUPT = 2;
+    static constexpr std::uint8_t INTERNED = 4;
+    static constexpr std::uint8_t UTF8_SCANNED = 8;
+    static constexpr std::uint8_t UTF8_VALID = 16;
+
+    object_t        _type;
+    std::uint8_t    _gc_bits = 0;
+    std::uint8_t    _flags = 0;
+    std::uint32_t   _hash = 0;
 };
 
-using builtin_fn_t = std::function<object*(std::vector<object*>)>;
+/**
+ * Checked downcast by type tag, nullptr if obj is not a T.
+ */
+template <typename T>
+T* as(object* obj) noexcept { 
+    return obj != nullptr && obj->type() == T::tag ? static_cast<T*>(obj) : nullptr; 
+}
+
+template <typename T>
+const T* as(const object* obj) noexcept { 
+    return obj != nullptr && obj->type() == T::tag ? static_cast<const T*>(obj) : nullptr; 
+}
+
+/**
+ * Arguments of a call, a view into the evaluator's value stack.
+ */
+using args_t = std::span<object* const>;
+
+using builtin_fn_t = object* (*)(args_t args) noexcept;
+
+/**
+ * View of the free variables captured by a closure, (*names)[i] is bound to the
+ * binding slot slots[i] of the scope that defines it, so assignments on either
+ * side are seen by the other. A slot is null when the name was not bound yet at
+ * creation.
+ */
+struct captures {
+    const std::vector<std::string>*     names = nullptr;
+    object** const*                     slots = nullptr;
+
+    object** find(std::string_view name) const noexcept {
+        if(names == nullptr) {
+            return nullptr;
+        }
+        for(std::size_t i = 0; i < names->size(); i++) {
+            if((*names)[i] == name) {
+                return slots[i];
+            }
+        }
+        return nullptr;
+    }
+};
 
 class scope {
 public:
@@ -37,21 +159,69 @@ public:
      */
     scope(scope* outer) noexcept : _outer(outer) {}
 
+    /**
+     * Initializes a call frame that resolves names from its own bindings, then
+     * from the captured free variables of the closure, then from outer
+     */
+    scope(scope* outer, captures captured) noexcept : _outer(outer), _captured(captured) {}
+
+    static void* operator new(std::size_t size) { return pool::local().allocate(size); }
+    static void operator delete(void* p, std::size_t size) noexcept { pool::local().deallocate(p, size); }
+
     object* get(std::string name) const noexcept {
-        auto it = _store.find(name);
-        if(it == _store.end() && _outer != nullptr) {
-            return _outer->get(name);
-        } else if (it == _store.end()) {
-            return nullptr;
-        }
-        return it->second;
+        object** binding = slot(name);
+        return binding != nullptr ? *binding : nullptr;
     }
 
+    /**
+     * Binds name in this scope, shadowing any outer binding.
+     */
     object* set(std::string name, object* val) noexcept {
         _store[name] = val;
         return val;
     }
 
+    /**
+     * Rebinds name in the scope that defines it, returns nullptr if no scope does.
+     */
+    object* assign(const std::string& name, object* val) noexcept {
+        object** binding = slot(name);
+        if(binding == nullptr) {
+            return nullptr;
+        }
+        *binding = val;
+        return val;
+    }
+
+    /**
+     * Storage of the binding name resolves to, stable for the lifetime of the
+     * scope unless it is reset.
+     */
+    object** slot(const std::string& name) const noexcept {
+        auto it = _store.find(name);
+        if(it != _store.end()) {
+            return const_cast<object**>(&it->second);
+        }
+        if(object** captured = _captured.find(name)) {
+            return captured;
+        }
+        if(_outer != nullptr) {
+            return _outer->slot(name);
+        }
+        return nullptr;
+    }
+
+    void reserve(std::size_t bindings) noexcept { _store.reserve(bindings); }
+
+    /**
+     * Drops all bindings and re-parents the scope so it can be reused as a new frame.
+     */
+    void reset(scope* outer, captures captured) noexcept {
+        _store.clear();
+        _outer = outer;
+        _captured = captured;
+    }
+
     const size_t scope_size() const noexcept { 
         if(_outer != nullptr) {
             return _outer->scope_size() + _store.size(); 
@@ -72,167 +242,1147 @@ public:
     }
 
 protected:
-    scope*                                          _outer;
+    scope*                                          _outer = nullptr;
+    captures                                        _captured;
     std::unordered_map<std::string, object*>        _store;
 };
 
 class integer : public object {
 public:
-    integer() noexcept = default;
-    integer(std::int64_t value) noexcept : _value(value), _to_string(std::to_string(value)) {}
-    ~integer() noexcept = default;
+    static constexpr object_t tag = INTEGER_OBJ;
+
+    integer(std::int64_t value) noexcept : object(tag), _value(value) {}
 
     std::int64_t value() const noexcept { return _value; } 
 
-    const std::string& inspect() const noexcept { return _to_string; }
-    const object_t& type() const noexcept { return INTEGER_OBJ; }
 private:
-    std::string     _to_string;
     std::int64_t    _value;
 };
 
 
 class boolean : public object {
 public:
-    boolean() noexcept = default;
-    boolean(bool value) noexcept : _value(value), _to_string(std::to_string(value)) {}
+    static constexpr object_t tag = BOOLEAN_OBJ;
+
+    boolean(bool value) noexcept : object(tag), _value(value) {}
 
     bool value() const noexcept { return _value; } 
 
-    const std::string& inspect() const noexcept { return _to_string; }
-    const object_t& type() const noexcept { return BOOLEAN_OBJ; }
 private:
-    std::string     _to_string;
     bool            _value;
 };
 
 
 class null : public object {
 public:
-    null() noexcept = default;
-
-    const std::string& inspect() const noexcept { return _to_string; }
-    const object_t& type() const noexcept { return NULL_OBJ; }
+    static constexpr object_t tag = NULL_OBJ;
 
-private:
-    std::string     _to_string = "null";
+    null() noexcept : object(tag) {}
 };
 
 
 class return_value : public object {
 public:
-    return_value(std::shared_ptr<object> value) noexcept : _value(value) {}
+    static constexpr object_t tag = RETURN_VALUE_OBJ;
+
+    return_value(object* value) noexcept : object(tag), _value(value) { _flags = ABRUPT; }
     
-    object* value() const noexcept { return _value.get(); }
+    object* value() const noexcept { return _value; }
 
-    const std::string& inspect() const noexcept { return _value->inspect(); }
-    const object_t& type() const noexcept { return RETURN_VALUE_OBJ; }
 private:
-    std::shared_ptr<object> _value;
+    object*         _value;
 };
 
 
+/**
+ * Error value, an error code plus the operands of the failed operation. The
+ * message is only formatted when the error is inspected, see message().
+ *
+ * Errors that depend on operand types alone are shared, of() hands out one
+ * immutable instance per code, types and operator, so a script that keeps 
+ * running into the same type error allocates nothing. Shared errors must not
+ * be destroyed.
+ */
 class error : public object {
 public:
-    error() noexcept = default;
-    error(std::string&& msg) noexcept : _message(std::move(msg)) {}
+    static constexpr object_t tag = ERROR_OBJ;
+
+    error(std::string&& msg) noexcept : error(CUSTOM_ERR) { _text = std::move(msg); }
+    error(error_t code, std::string_view name) noexcept : error(code) { _text = name; }
+    error(error_t code, std::int64_t got = 0, std::int64_t want = 0) noexcept 
+        : object(tag), _code(code), _got(got), _want(want) { _flags = ABRUPT; }
+
+    /**
+     * The shared error for code on operands of type left and right, op is the
+     * operator, at most 2 characters. Unary errors pass their operand as right.
+     */
+    static error* of(error_t code, object_t left, std::string_view op, object_t right) noexcept {
+        thread_local std::unordered_map<std::uint64_t, error*> shared;
+        char op_chars[2] = {
+            op.size() > 0 ? op[0] : '\0', 
+            op.size() > 1 ? op[1] : '\0' 
+        };
+        std::uint64_t key = static_cast<std::uint64_t>(code) << 32 | static_cast<std::uint64_t>(left) << 24 
+            | static_cast<std::uint64_t>(right) << 16 | static_cast<std::uint8_t>(op_chars[0]) << 8 
+            | static_cast<std::uint8_t>(op_chars[1]);
+        error*& e = shared[key];
+        if(e == nullptr) {
+            e = new error(code);
+            e->_left = left;
+            e->_right = right;
+            e->_op[0] = op_chars[0];
+            e->_op[1] = op_chars[1];
+        }
+        return e;
+    }
 
-    const std::string& inspect() const noexcept { return _message; }
-    const object_t& type() const noexcept { return ERROR_OBJ; }
+    static error* of(error_t code, object_t operand) noexcept { return of(code, operand, {}, operand); }
+
+    /**
+     * The shared error for an argument of type got passed to the builtin name,
+     * which must be a string literal.
+     */
+    static error* argument(std::string_view name, object_t got) noexcept {
+        thread_local std::unordered_map<const char*, std::array<error*, object_count>> shared;
+        error*& e = shared[name.data()][got];
+        if(e == nullptr) {
+            e = new error(ARGUMENT_TYPE_ERR, name);
+            e->_right = got;
+        }
+        return e;
+    }
+
+    error_t code() const noexcept { return _code; }
+    object_t left() const noexcept { return _left; }
+    object_t right() const noexcept { return _right; }
+    std::string_view op() const noexcept { return std::string_view(_op, _op[1] != '\0' ? 2 : _op[0] != '\0' ? 1 : 0); }
+
+    std::string message() const noexcept {
+        std::string buf;
+        message(buf);
+        return buf;
+    }
+
+    void message(std::string& buf) const noexcept {
+        switch(_code) {
+        case CUSTOM_ERR:
+            buf += _text;
+            break;
+        case TYPE_MISMATCH_ERR:
+        case UNKNOWN_OPERATOR_ERR:
+            buf += _code == TYPE_MISMATCH_ERR ? "type mismatch: " : "unknown operator: ";
+            buf += inv_map[_left];
+            buf += ' ';
+            buf += op();
+            buf += ' ';
+            buf += inv_map[_right];
+            break;
+        case UNKNOWN_PREFIX_ERR:
+            buf += "unknown operator: ";
+            buf += op();
+            buf += inv_map[_right];
+            break;
+        case INDEX_OPERATOR_ERR:
+        case INDEX_ASSIGNMENT_ERR:
+        case SLICE_OPERATOR_ERR:
+            buf += _code == INDEX_OPERATOR_ERR ? "index operator not supported: " 
+                : _code == INDEX_ASSIGNMENT_ERR ? "index assignment not supported: " : "slice operator not supported: ";
+            buf += inv_map[_left];
+            buf += ' ';
+            buf += inv_map[_right];
+            break;
+        case FOR_IN_ERR:
+            buf += "for-in not supported: ";
+            buf += inv_map[_right];
+            break;
+        case NOT_A_FUNCTION_ERR:
+            buf += "not a function: ";
+            buf += inv_map[_right];
+            break;
+        case HASH_KEY_ERR:
+            buf += "unusable as hash key: ";
+            buf += inv_map[_right];
+            break;
+        case ARGUMENT_TYPE_ERR:
+            buf += "argument to ";
+            buf += _text;
+            buf += " not supported, got ";
+            buf += inv_map[_right];
+            break;
+        case STACK_OVERFLOW_ERR:
+            buf += "stack overflow";
+            break;
+        case DIVISION_BY_ZERO_ERR:
+            buf += "division by zero";
+            break;
+        case RANGE_STEP_ERR:
+            buf += "range step cannot be zero";
+            break;
+        case IDENTIFIER_ERR:
+            buf += "identifier not found: ";
+            buf += _text;
+            break;
+        case ASSIGN_TARGET_ERR:
+            buf += "cannot assign to ";
+            buf += _text;
+            break;
+        case ARGUMENT_COUNT_ERR:
+            buf += "wrong number of arguments. got=";
+            buf += std::to_string(_got);
+            buf += ", want=";
+            buf += std::to_string(_want);
+            break;
+        case INDEX_RANGE_ERR:
+            buf += "index out of range: ";
+            buf += std::to_string(_got);
+            break;
+        case LENGTH_MISMATCH_ERR:
+            buf += "length mismatch: ";
+            buf += std::to_string(_got);
+            buf += " and ";
+            buf += std::to_string(_want);
+            break;
+        }
+    }
 
 private:
-    std::string _message;
+    error_t         _code;
+    object_t        _left = NULL_OBJ;
+    object_t        _right = NULL_OBJ;
+    char            _op[2] = {'\0', '\0'};
+    std::int64_t    _got;
+    std::int64_t    _want;
+    std::string     _text;      // free-form message, identifier or assignment target
 };
 
 
+/**
+ * Closure over the free variables of its literal, everything else is shared
+ * through the prototype of the literal. The binding slots of the free variables
+ * are looked up by the evaluator on creation. The defining scope is only
+ * retained as a fallback when some name could not be resolved yet, e.g. a
+ * function defined later.
+ */
 class function : public object {
 public:
-    function(std::vector<std::shared_ptr<ast::identifier>> parameters, 
-            std::shared_ptr<const ast::block_statement> body, scope* scope) 
-        noexcept : _parameters(std::move(parameters)), _body(body), _scope(scope) { build_to_string(); }
+    static constexpr object_t tag = FUNCTION_OBJ;
+    static constexpr std::size_t inline_captures = 3;
+
+    function(std::shared_ptr<const ast::prototype> proto, scope* fallback) noexcept 
+        : object(tag), _prototype(std::move(proto)), _scope(fallback), _slots(_inline) {
+        std::size_t count = _prototype->free_variables.size();
+        if(count > inline_captures) {
+            _slots = new object**[count];
+        }
+        std::fill(_slots, _slots + count, nullptr);
+    }
+
+    function(const function&) = delete;
+    function& operator=(const function&) = delete;
+
+    ~function() noexcept {
+        if(_slots != _inline) {
+            delete[] _slots;
+        }
+    }
+
+    const ast::prototype& proto() const noexcept { return *_prototype; }
+    const std::vector<std::shared_ptr<ast::identifier>>& parameters() const noexcept { return _prototype->parameters; }
+    std::shared_ptr<const ast::block_statement> body() const noexcept { return _prototype->body; }
+    bool frame_escapes() const noexcept { return _prototype->frame_escapes; }
 
-    const std::vector<std::shared_ptr<ast::identifier>>& parameters() const noexcept { return _parameters; }
-    std::shared_ptr<const ast::block_statement> body() const noexcept { return _body; }
+    captures captured() const noexcept { return captures{&_prototype->free_variables, _slots}; }
+    void capture(std::size_t i, object** slot) noexcept { _slots[i] = slot; }
+
+    /**
+     * Scope consulted for names that were unresolved on creation, null if none were.
+     */
     scope* get_scope() const noexcept { return _scope; }
+    void set_scope(scope* fallback) noexcept { _scope = fallback; }
 
-    const std::string& inspect() const noexcept { return _to_string; }
-    const object_t& type() const noexcept { return FUNCTION_OBJ; }
-    
-private:
-    void build_to_string() noexcept {
-        _to_string += "fn(";
-        for(int i=0;i<_parameters.size();i++){
-            _to_string += _parameters[i]->to_string() + ',';
+    /**
+     * Points the unresolved free variables called name at slot, used when the
+     * function is bound to name so that it can call itself.
+     */
+    void bind_self(std::string_view name, object** slot) noexcept {
+        for(std::size_t i = 0; i < _prototype->free_variables.size(); i++) {
+            if(_slots[i] == nullptr && _prototype->free_variables[i] == name) {
+                _slots[i] = slot;
+            }
         }
-        _to_string += ")";
-        _to_string += _body->to_string();
     }
 
-    scope*                                                  _scope;
-    std::string                                             _to_string;
-    std::shared_ptr<const ast::block_statement>             _body;
-    std::vector<std::shared_ptr<ast::identifier>>           _parameters;
+    void inspect(std::string& buf) const noexcept {
+        ast::writer w;
+        w << "fn(";
+        for(const auto& param : _prototype->parameters){
+            w << param->value() << ',';
+        }
+        w << ")";
+        _prototype->body->write(w);
+        buf += w.str();
+    }
+    
+private:
+    std::shared_ptr<const ast::prototype>   _prototype;
+    scope*                                  _scope;
+    object***                               _slots;     // _inline, or a heap array for more captures
+    object**                                _inline[inline_captures];
 };
 
 
+/**
+ * Immutable string, stored either flat or as a rope: a concatenation node over
+ * two strings, so that s + t costs O(1) instead of copying both sides. A rope
+ * is flattened in place the first time its contiguous bytes are needed (see
+ * value()), its size is known without flattening.
+ *
+ * A string can also be a view of a range of bytes of a flat string, see 
+ * slice(), the viewed string is kept alive by the view.
+ *
+ * concat() copies results shorter than flat_limit, tiny ropes don't pay for
+ * themselves. A rope deeper than max_depth is rebalanced: its leaves are 
+ * gathered, runs of short leaves are merged into chunks of at least half of 
+ * leaf_chunk bytes, and a balanced tree is built over them. Chunks are never
+ * copied again, so building a string out of many fragments stays linear.
+ */
 class string : public object {
 public:
-    string(std::string value) noexcept : _value(value) {}
+    static constexpr object_t tag = STRING_OBJ;
+    static constexpr std::size_t flat_limit = 64;
+    static constexpr std::size_t leaf_chunk = 1024;
+    static constexpr std::uint32_t max_depth = 256;
+
+    string(std::string value) noexcept : object(tag), _value(std::move(value)), _size(_value.size()) { scan(); }
+
+    /**
+     * left followed by right, either of which may be returned if the other is empty.
+     */
+    static string* concat(string* left, string* right) noexcept;
+
+    /**
+     * Contiguous contents, flattens the rope on first use.
+     */
+    std::string_view value() const noexcept {
+        if(_left != nullptr) {
+            flatten();
+        }
+        if(_base != nullptr) {
+            return std::string_view(_base->_value).substr(_offset, _size);
+        }
+        return _value;
+    }
+
+    std::size_t size() const noexcept { return _size; }
+    bool is_rope() const noexcept { return _left != nullptr; }
+    bool is_view() const noexcept { return _base != nullptr; }
+    std::uint32_t depth() const noexcept { return _depth; }
+
+    /**
+     * Whether the contents are valid UTF-8. Strings are validated when they are
+     * created, a rope of two scanned strings is usually known to be valid or not
+     * without a scan. Strings that are not valid UTF-8 are treated as bytes by
+     * length() and at().
+     */
+    bool is_utf8() noexcept {
+        scan();
+        return _flags & UTF8_VALID;
+    }
+
+    /**
+     * Length in characters, code points for valid UTF-8 and bytes otherwise.
+     */
+    std::size_t length() noexcept { return is_utf8() ? _code_points : _size; }
+
+    /**
+     * The character at index i as a string, nullptr if i is out of range. 
+     * ASCII characters are interned.
+     */
+    string* at(std::int64_t i) noexcept {
+        if(i < 0 || static_cast<std::size_t>(i) >= length()) {
+            return nullptr;
+        }
+        std::string_view bytes = value();
+        if(_code_points == _size || !is_utf8()) {
+            return intern(bytes.substr(i, 1));
+        }
+        std::size_t begin = utf8::offset(bytes, i);
+        std::size_t n = utf8::sequence_length(static_cast<unsigned char>(bytes[begin]));
+        return new string(std::string(bytes.substr(begin, n)));
+    }
+
+    /**
+     * Characters [begin, end), both clamped to [0, length()]. Slices shorter
+     * than flat_limit bytes are copied, longer ones view the bytes of this 
+     * string, which is flattened first if it is a rope.
+     */
+    string* slice(std::int64_t begin, std::int64_t end) noexcept {
+        std::size_t n = length();
+        std::size_t b = static_cast<std::size_t>(std::clamp<std::int64_t>(begin, 0, n));
+        std::size_t e = std::max(b, static_cast<std::size_t>(std::clamp<std::int64_t>(end, 0, n)));
+        std::string_view bytes = value();
+        std::size_t from = b, to = e;
+        bool bytewise = !is_utf8() || _code_points == _size;
+        if(!bytewise) {
+            from = utf8::offset(bytes, b);
+            to = from + utf8::offset(bytes.substr(from), e - b);
+        }
+        if(from == 0 && to == _size) {
+            return this;
+        }
+        if(to - from < flat_limit) {
+            return new string(std::string(bytes.substr(from, to - from)));
+        }
+        string* view = _base != nullptr ? new string(_base, _offset + from, to - from) : new string(this, from, to - from);
+        if(is_utf8()) {
+            // cut on code point boundaries, so the view is valid too
+            view->_code_points = e - b;
+            view->_flags |= UTF8_SCANNED | UTF8_VALID;
+        }
+        return view;
+    }
 
-    const std::string& value() const noexcept { return _value; }
+    /**
+     * The thread's unique string with contents value, created with its hash on
+     * first use. Interned strings are immutable and never freed.
+     */
+    static string* intern(std::string_view value) noexcept {
+        thread_local std::unordered_map<std::string_view, string*> table;
+        auto it = table.find(value);
+        if(it != table.end()) {
+            return it->second;
+        }
+        string* s = new string(std::string(value));
+        s->_flags |= INTERNED;
+        s->hash();
+        table.emplace(s->value(), s); // the key views the interned string itself
+        return s;
+    }
 
-    const std::string& inspect() const noexcept { return _value; }
-    const object_t& type() const noexcept { return STRING_OBJ; }
+    bool interned() const noexcept { return _flags & INTERNED; }
+
+    /**
+     * Equality of contents. Two interned strings are equal only if they are the
+     * same object, and strings whose hashes are both cached and differ are not
+     * equal, so only the remaining cases compare bytes.
+     */
+    bool equals(const string* other) const noexcept {
+        if(this == other) {
+            return true;
+        }
+        if(interned() && other->interned()) {
+            return false;
+        }
+        if(_size != other->_size) {
+            return false;
+        }
+        if((_flags & other->_flags & HASH_CACHED) && _hash != other->_hash) {
+            return false;
+        }
+        return value() == other->value();
+    }
     
 private:
-    std::string _value;
+    string(string* left, string* right) noexcept 
+        : object(tag), _left(left), _right(right), _size(left->_size + right->_size), 
+          _depth(std::max(left->_depth, right->_depth) + 1) {
+        if(!(left->_flags & right->_flags & UTF8_SCANNED)) {
+            return;
+        }
+        bool left_valid = left->_flags & UTF8_VALID;
+        bool right_valid = right->_flags & UTF8_VALID;
+        // only a sequence left open by an invalid left side can be completed by
+        // the continuation bytes that start the right side, found by a scan
+        if(!left_valid && (right->front() & 0xc0) == 0x80) {
+            return;
+        }
+        _code_points = left->_code_points + right->_code_points;
+        _flags |= left_valid && right_valid ? UTF8_SCANNED | UTF8_VALID : UTF8_SCANNED;
+    }
+
+    string(const string* base, std::size_t offset, std::size_t size) noexcept
+        : object(tag), _base(base), _size(size), _offset(offset) {}
+
+    void scan() noexcept {
+        if(_flags & UTF8_SCANNED) {
+            return;
+        }
+        utf8::info info = utf8::scan(value());
+        _code_points = info.code_points;
+        _flags |= info.valid ? UTF8_SCANNED | UTF8_VALID : UTF8_SCANNED;
+    }
+
+    // the first byte of a non-empty string
+    unsigned char front() const noexcept {
+        const string* s = this;
+        while(s->_left != nullptr) {
+            s = s->_left;
+        }
+        return s->_base != nullptr ? s->_base->_value[s->_offset] : s->_value[0];
+    }
+
+    // appends the leaves of this rope, left to right, without recursing
+    void leaves(std::vector<const string*>& out) const noexcept;
+    void flatten() const noexcept;
+    void rebalance() noexcept;
+    static string* build(const std::vector<string*>& leaves, std::size_t begin, std::size_t end) noexcept;
+
+    mutable std::string     _value;             // contents, empty while this is a rope or a view
+    mutable string*         _left = nullptr;
+    mutable string*         _right = nullptr;
+    const string*           _base = nullptr;    // flat string viewed from _offset
+    std::size_t             _size;
+    std::size_t             _offset = 0;
+    std::size_t             _code_points = 0;
+    mutable std::uint32_t   _depth = 0;
 };
 
+inline string* string::concat(string* left, string* right) noexcept {
+    if(left->_size == 0) {
+        return right;
+    }
+    if(right->_size == 0) {
+        return left;
+    }
+    if(left->_size + right->_size < flat_limit) {
+        std::string flat;
+        flat.reserve(left->_size + right->_size);
+        flat += left->value();
+        flat += right->value();
+        return new string(std::move(flat));
+    }
+    string* rope = new string(left, right);
+    if(rope->_depth > max_depth) {
+        rope->rebalance();
+    }
+    return rope;
+}
+
+inline void string::leaves(std::vector<const string*>& out) const noexcept {
+    std::vector<const string*> pending{this};
+    while(!pending.empty()) {
+        const string* s = pending.back();
+        pending.pop_back();
+        if(s->_left == nullptr) {
+            out.push_back(s);
+        } else {
+            pending.push_back(s->_right);
+            pending.push_back(s->_left);
+        }
+    }
+}
+
+inline void string::flatten() const noexcept {
+    std::vector<const string*> parts;
+    leaves(parts);
+    _value.reserve(_size);
+    for(const string* part : parts) {
+        _value += part->value();
+    }
+    _left = _right = nullptr;
+    _depth = 0;
+}
+
+inline void string::rebalance() noexcept {
+    std::vector<const string*> parts;
+    leaves(parts);
+    std::vector<string*> chunks;
+    std::string run;
+    for(const string* part : parts) {
+        // leaves of at least half a chunk are kept as they are, so no byte is merged twice
+        if(part->_size >= leaf_chunk / 2) {
+            if(!run.empty()) {
+                chunks.push_back(new string(std::move(run)));
+                run.clear();
+            }
+            chunks.push_back(const_cast<string*>(part));
+            continue;
+        }
+        run += part->value();
+        if(run.size() >= leaf_chunk / 2) {
+            chunks.push_back(new string(std::move(run)));
+            run.clear();
+        }
+    }
+    if(!run.empty()) {
+        chunks.push_back(new string(std::move(run)));
+    }
+    if(chunks.size() == 1) {
+        _value = chunks[0]->value();
+        _left = _right = nullptr;
+        _depth = 0;
+        return;
+    }
+    std::size_t mid = chunks.size() / 2;
+    _left = build(chunks, 0, mid);
+    _right = build(chunks, mid, chunks.size());
+    _depth = std::max(_left->_depth, _right->_depth) + 1;
+}
+
+inline string* string::build(const std::vector<string*>& leaves, std::size_t begin, std::size_t end) noexcept {
+    if(end - begin == 1) {
+        return leaves[begin];
+    }
+    std::size_t mid = begin + (end - begin) / 2;
+    return new string(build(leaves, begin, mid), build(leaves, mid, end));
+}
+
 
 class builtin : public object {
 public:
-    builtin() noexcept = default;
-    builtin(builtin_fn_t fn) noexcept : _fn(fn) {};
+    static constexpr object_t tag = BUILTIN_OBJ;
 
-    builtin_fn_t fn() noexcept { return _fn; }
+    builtin(builtin_fn_t fn) noexcept : object(tag), _fn(fn) {};
 
-    const std::string& inspect() const noexcept { return _inspect; }
-    const object_t& type() const noexcept { return BUILTIN_OBJ; }
+    builtin_fn_t fn() const noexcept { return _fn; }
     
 private:
-    std::string     _inspect = "builtin function";
     builtin_fn_t    _fn;
 };
 
 
+/**
+ * Array of objects, a window of _size elements into contiguous storage, a
+ * persistent vector or contiguous raw integers, all shared with the slices of 
+ * the array.
+ *
+ * Contiguous storage is copied by the first store into it while it is shared,
+ * so a slice behaves as a copy of its elements while taking it costs O(1).
+ * The functional updates push(), updated() and concat() return arrays on a
+ * persistent vector (see persistent_vector.hpp). Updates of a persistent array
+ * share its structure, so they cost O(1) or O(log32 n) instead of a copy, the
+ * first update of any other array copies it into a new vector and leaves the
+ * array itself as it is.
+ *
+ * An array built from integers only keeps their values unboxed, see int64(),
+ * for the numeric builtins. at() boxes the element it reads. Storing anything
+ * but an integer into it boxes the whole array first.
+ *
+ * Persistent and integer arrays are copied into contiguous storage the first
+ * time elements() is asked for, at() and size() work on any form.
+ */
 class array : public object {
 public:
-    array(std::vector<object*> elements) noexcept {
-        for(object* e : elements) {
-            _elements.push_back(std::shared_ptr<object>(e));
+    static constexpr object_t tag = ARRAY_OBJ;
+
+    array(std::vector<object*> elements) noexcept 
+        : object(tag), _storage(std::make_shared<std::vector<object*>>(std::move(elements))), _size(_storage->size()) {}
+
+    /**
+     * An integer array holding values unboxed.
+     */
+    static array* of_int64(std::vector<std::int64_t> values) noexcept {
+        std::size_t size = values.size();
+        return new array(std::make_shared<std::vector<std::int64_t>>(std::move(values)), 0, size);
+    }
+
+    /**
+     * Contiguous elements, a persistent or integer array is copied on first use.
+     */
+    std::span<object* const> elements() const noexcept { 
+        if(_form != form::boxed) {
+            box();
         }
-        build_to_string();
-    };
+        return std::span<object* const>(_storage->data() + _offset, _size); 
+    }
+
+    std::size_t size() const noexcept { return _size; }
+    bool is_persistent() const noexcept { return _form == form::persistent; }
+    bool is_int64() const noexcept { return _form == form::int64; }
+
+    /**
+     * Unboxed elements of an integer array, see is_int64().
+     */
+    std::span<const std::int64_t> int64() const noexcept { return std::span<const std::int64_t>(_ints->data() + _offset, _size); }
+
+    /**
+     * Element i, which must be in range.
+     */
+    object* at(std::size_t i) const noexcept { 
+        switch(_form) {
+        case form::persistent:  return _vector.at(_offset + i);
+        case form::int64:       return new integer((*_ints)[_offset + i]);
+        default:                return (*_storage)[_offset + i];
+        }
+    }
+
+    /**
+     * Whether the contiguous storage is shared with a slice or with the array a slice was taken from.
+     */
+    bool shares_storage() const noexcept { 
+        return _form == form::boxed ? _storage.use_count() > 1 : _form == form::int64 && _ints.use_count() > 1; 
+    }
+
+    /**
+     * Replaces the element at i, i must be in range. Shared storage is copied first.
+     */
+    void set(std::size_t i, object* val) noexcept { 
+        if(_form == form::persistent) {
+            _vector = _vector.set(_offset + i, val);
+            return;
+        }
+        if(_form == form::int64) {
+            if(auto n = as<integer>(val)) {
+                if(_ints.use_count() > 1) {
+                    _ints = std::make_shared<std::vector<std::int64_t>>(int64().begin(), int64().end());
+                    _offset = 0;
+                }
+                (*_ints)[_offset + i] = n->value();
+                return;
+            }
+            box();
+        }
+        if(shares_storage()) {
+            std::span<object* const> window = elements();
+            _storage = std::make_shared<std::vector<object*>>(window.begin(), window.end());
+            _offset = 0;
+        }
+        (*_storage)[_offset + i] = val;
+    }
+
+    /**
+     * Elements [begin, end), both clamped to [0, size()], sharing this array's storage.
+     */
+    array* slice(std::int64_t begin, std::int64_t end) noexcept {
+        std::size_t b = static_cast<std::size_t>(std::clamp<std::int64_t>(begin, 0, _size));
+        std::size_t e = std::max(b, static_cast<std::size_t>(std::clamp<std::int64_t>(end, 0, _size)));
+        switch(_form) {
+        case form::persistent:  return new array(_vector, _offset + b, e - b);
+        case form::int64:       return new array(_ints, _offset + b, e - b);
+        default:                return new array(_storage, _offset + b, e - b);
+        }
+    }
+
+    /**
+     * A new array with val appended.
+     */
+    array* push(object* val) const noexcept {
+        std::size_t offset;
+        persistent_vector vector = persistent(offset);
+        return new array(vector.push(val), offset, _size + 1);
+    }
 
-    const std::vector<std::shared_ptr<object>>& elements() const noexcept { return _elements; }
+    /**
+     * A new array with element i replaced by val, i must be in range.
+     */
+    array* updated(std::size_t i, object* val) const noexcept {
+        std::size_t offset;
+        persistent_vector vector = persistent(offset);
+        return new array(vector.set(offset + i, val), offset, _size);
+    }
+
+    /**
+     * A new array with the elements of other appended, sharing the structure of this one.
+     */
+    array* concat(const array* other) const noexcept {
+        std::size_t offset;
+        persistent_vector res = persistent(offset);
+        for(std::size_t i = 0; i < other->size(); i++) {
+            res = res.push(other->at(i));
+        }
+        return new array(std::move(res), offset, _size + other->size());
+    }
 
-    const object_t& type() const noexcept { return ARRAY_OBJ; }
-    const std::string& inspect() const noexcept { return _to_string; }
+    void inspect(std::string& buf) const noexcept {
+        buf += "[";
+        for (std::size_t i = 0; i < _size; i++) {
+            if(_form == form::int64) {
+                buf += std::to_string((*_ints)[_offset + i]);
+            } else {
+                at(i)->inspect(buf);
+            }
+            if (i != _size - 1) { buf += ", "; }
+        }
+        buf += "]";
+    }
     
 private:
-    void build_to_string() noexcept {
-        _to_string += "[";
-        for (int i = 0; i < _elements.size(); i++) {
-            _to_string += _elements[i]->inspect();
-            if (i != _elements.size() - 1) { _to_string += ", "; }
+    enum class form : std::uint8_t { boxed, persistent, int64 };
+
+    array(std::shared_ptr<std::vector<object*>> storage, std::size_t offset, std::size_t size) noexcept
+        : object(tag), _storage(std::move(storage)), _offset(offset), _size(size) {}
+
+    array(persistent_vector vector, std::size_t offset, std::size_t size) noexcept
+        : object(tag), _vector(std::move(vector)), _offset(offset), _size(size), _form(form::persistent) {}
+
+    array(std::shared_ptr<std::vector<std::int64_t>> ints, std::size_t offset, std::size_t size) noexcept
+        : object(tag), _ints(std::move(ints)), _offset(offset), _size(size), _form(form::int64) {}
+
+    /**
+     * Copies the elements into contiguous storage of their own.
+     */
+    void box() const noexcept {
+        std::vector<object*> flat(_size);
+        for(std::size_t i = 0; i < _size; i++) {
+            flat[i] = at(i);
+        }
+        _storage = std::make_shared<std::vector<object*>>(std::move(flat));
+        _vector = persistent_vector();
+        _ints.reset();
+        _offset = 0;
+        _form = form::boxed;
+    }
+
+    /**
+     * A persistent vector that holds the elements from offset on and ends where
+     * this array ends, so that it can be pushed onto. It is this array's own
+     * vector if it has one, otherwise the elements are copied into a new one.
+     */
+    persistent_vector persistent(std::size_t& offset) const noexcept {
+        if(_form == form::persistent && _offset + _size == _vector.size()) {
+            offset = _offset;
+            return _vector;
         }
-        _to_string += "]";
+        persistent_vector res;
+        for(std::size_t i = 0; i < _size; i++) {
+            res = res.push(at(i));
+        }
+        offset = 0;
+        return res;
     }
 
-    std::string                             _to_string;
-    std::vector<std::shared_ptr<object>>    _elements;
+    mutable std::shared_ptr<std::vector<object*>>       _storage;
+    mutable persistent_vector                           _vector;
+    mutable std::shared_ptr<std::vector<std::int64_t>>  _ints;
+    mutable std::size_t                                 _offset = 0;
+    std::size_t                                         _size;
+    mutable form                                        _form = form::boxed;
 };
 
-} // namespace object
 
+/**
+ * Hash map from integers, booleans and strings to objects, see swiss_table.
+ * Keys use the hash cached in their header, so a string is hashed once for all
+ * the maps it is used with. Iteration is in insertion order.
+ */
+class hash_map : public object {
+public:
+    static constexpr object_t tag = HASH_OBJ;
+
+    hash_map() noexcept : object(tag) {}
+
+    /**
+     * Whether key can be used as a key, only values compared by contents can.
+     */
+    static bool hashable(const object* key) noexcept {
+        return key->type() == INTEGER_OBJ || key->type() == BOOLEAN_OBJ || key->type() == STRING_OBJ;
+    }
 
+    std::size_t size() const noexcept { return _table.size(); }
+    std::size_t capacity() const noexcept { return _table.capacity(); }
+    void reserve(std::size_t n) noexcept { _table.reserve(n); }
+
+    /**
+     * The value bound to the hashable key, nullptr if there is none.
+     */
+    object* get(object* key) noexcept {
+        object** value = _table.find(key);
+        return value != nullptr ? *value : nullptr;
+    }
+
+    /**
+     * Binds the hashable key to value.
+     */
+    void set(object* key, object* value) noexcept { _table.insert(key, value); }
+
+    /**
+     * Calls fn(key, value) for every pair in insertion order.
+     */
+    template <typename Fn>
+    void for_each(Fn&& fn) const noexcept {
+        for(const auto& e : _table.entries()) {
+            fn(e.key, e.value);
+        }
+    }
+
+    void inspect(std::string& buf) const noexcept;
+
+private:
+    struct key_hash {
+        std::uint32_t operator()(object* key) const noexcept { return key->hash(); }
+    };
+
+    struct key_equal {
+        bool operator()(const object* a, const object* b) const noexcept;
+    };
+
+    swiss_table<object*, object*, key_hash, key_equal>  _table;
+};
+
+
+/**
+ * The integers from start up to, not including, end in steps of step, which
+ * is not 0. Elements are computed on demand, a range of any length takes the
+ * same space.
+ */
+class range : public object {
+public:
+    static constexpr object_t tag = RANGE_OBJ;
+
+    range(std::int64_t start, std::int64_t end, std::int64_t step) noexcept 
+        : object(tag), _start(start), _end(end), _step(step) {}
+
+    std::int64_t start() const noexcept { return _start; }
+    std::int64_t end() const noexcept { return _end; }
+    std::int64_t step() const noexcept { return _step; }
+
+    std::size_t size() const noexcept {
+        if(_step > 0 ? _start >= _end : _start <= _end) {
+            return 0;
+        }
+        std::uint64_t span = _step > 0 ? static_cast<std::uint64_t>(_end) - static_cast<std::uint64_t>(_start) 
+            : static_cast<std::uint64_t>(_start) - static_cast<std::uint64_t>(_end);
+        std::uint64_t stride = _step > 0 ? static_cast<std::uint64_t>(_step) : -static_cast<std::uint64_t>(_step);
+        return (span - 1) / stride + 1;
+    }
+
+    /**
+     * Element i, which must be in range.
+     */
+    std::int64_t at(std::size_t i) const noexcept { 
+        return static_cast<std::int64_t>(static_cast<std::uint64_t>(_start) + i * static_cast<std::uint64_t>(_step)); 
+    }
+
+    void inspect(std::string& buf) const noexcept {
+        buf += "range(" + std::to_string(_start) + ", " + std::to_string(_end);
+        if(_step != 1) {
+            buf += ", " + std::to_string(_step);
+        }
+        buf += ")";
+    }
+
+private:
+    std::int64_t    _start;
+    std::int64_t    _end;
+    std::int64_t    _step;
+};
+
+
+/**
+ * Lazy pipeline of map, filter and take stages over a range or an array. 
+ * Adding a stage to a sequence makes a new sequence over the same source with
+ * one more stage, so a chain of stages is run in one pass over the source,
+ * each element going through all stages before the next one is read, and no
+ * array is built between stages. Running the stages needs the evaluator, see
+ * evaluator::drain().
+ */
+class sequence : public object {
+public:
+    static constexpr object_t tag = SEQUENCE_OBJ;
+
+    enum class stage_kind : std::uint8_t { map, filter, take };
+
+    struct stage {
+        stage_kind      kind;
+        object*         fn = nullptr;   // map and filter
+        std::int64_t    count = 0;      // take
+    };
+
+    /**
+     * Sequence over a range or an array.
+     */
+    sequence(object* source, std::vector<stage> stages = {}) noexcept 
+        : object(tag), _source(source), _stages(std::move(stages)) {}
+
+    object* source() const noexcept { return _source; }
+    const std::vector<stage>& stages() const noexcept { return _stages; }
+
+    /**
+     * This sequence followed by s.
+     */
+    sequence* then(stage s) const noexcept {
+        std::vector<stage> stages = _stages;
+        stages.push_back(s);
+        return new sequence(_source, std::move(stages));
+    }
+
+private:
+    object*                 _source;
+    std::vector<stage>      _stages;
+};
+
+
+/**
+ * Iterator protocol over the source of a sequence, a range or an array. next()
+ * yields the elements in order and returns false after the last one.
+ */
+class cursor {
+public:
+    cursor(object* source) noexcept 
+        : _range(as<range>(source)), _array(as<array>(source)), 
+          _size(_range != nullptr ? _range->size() : _array != nullptr ? _array->size() : 0) {}
+
+    bool next(object*& out) noexcept {
+        if(_next == _size) {
+            return false;
+        }
+        out = _range != nullptr ? new integer(_range->at(_next)) : _array->at(_next);
+        ++_next;
+        return true;
+    }
+
+private:
+    const range*    _range;
+    const array*    _array;
+    std::size_t     _size;
+    std::size_t     _next = 0;
+};
+
+
+/**
+ * Function created by the flat evaluator, see flat_ast.hpp. Its printed form is
+ * owned by the flat program, which is opaque here.
+ */
+class flat_function : public object {
+public:
+    static constexpr object_t tag = FLAT_FUNCTION_OBJ;
+
+    flat_function(const flat::program* program, std::uint32_t literal, scope* scope, const std::string* to_string) 
+        noexcept : object(tag), _program(program), _literal(literal), _scope(scope), _to_string(to_string) {}
+
+    const flat::program* get_program() const noexcept { return _program; }
+    std::uint32_t literal() const noexcept { return _literal; }
+    scope* get_scope() const noexcept { return _scope; }
+
+    const std::string& to_string() const noexcept { return *_to_string; }
+
+private:
+    const flat::program*    _program;
+    std::uint32_t           _literal;
+    scope*                  _scope;
+    const std::string*      _to_string;
+};
+
+
+inline void object::inspect(std::string& buf) const noexcept {
+    switch(_type) {
+    case INTEGER_OBJ: {
+        char digits[24];
+        auto res = std::to_chars(digits, digits + sizeof(digits), static_cast<const integer*>(this)->value());
+        buf.append(digits, res.ptr);
+        break;
+    }
+    case BOOLEAN_OBJ:
+        buf += static_cast<const boolean*>(this)->value() ? "true" : "false";
+        break;
+    case NULL_OBJ:
+        buf += "null";
+        break;
+    case RETURN_VALUE_OBJ:
+        static_cast<const return_value*>(this)->value()->inspect(buf);
+        break;
+    case ERROR_OBJ:
+        static_cast<const error*>(this)->message(buf);
+        break;
+    case FUNCTION_OBJ:
+        static_cast<const function*>(this)->inspect(buf);
+        break;
+    case STRING_OBJ:
+        buf += static_cast<const string*>(this)->value();
+        break;
+    case BUILTIN_OBJ:
+        buf += "builtin function";
+        break;
+    case ARRAY_OBJ:
+        static_cast<const array*>(this)->inspect(buf);
+        break;
+    case FLAT_FUNCTION_OBJ:
+        buf += static_cast<const flat_function*>(this)->to_string();
+        break;
+    case HASH_OBJ:
+        static_cast<const hash_map*>(this)->inspect(buf);
+        break;
+    case RANGE_OBJ:
+        static_cast<const range*>(this)->inspect(buf);
+        break;
+    case SEQUENCE_OBJ:
+        buf += "lazy sequence";
+        break;
+    }
+}
+
+inline void hash_map::inspect(std::string& buf) const noexcept {
+    buf += "{";
+    for(const auto& e : _table.entries()) {
+        if(&e != _table.entries().data()) { buf += ", "; }
+        e.key->inspect(buf);
+        buf += ": ";
+        e.value->inspect(buf);
+    }
+    buf += "}";
+}
+
+inline bool hash_map::key_equal::operator()(const object* a, const object* b) const noexcept {
+    if(a == b) {
+        return true;
+    }
+    if(a->type() != b->type()) {
+        return false;
+    }
+    switch(a->type()) {
+    case INTEGER_OBJ:
+        return static_cast<const integer*>(a)->value() == static_cast<const integer*>(b)->value();
+    case BOOLEAN_OBJ:
+        return static_cast<const boolean*>(a)->value() == static_cast<const boolean*>(b)->value();
+    case STRING_OBJ:
+        return static_cast<const string*>(a)->equals(static_cast<const string*>(b));
+    default:
+        return false;
+    }
+}
+
+inline std::string object::inspect() const noexcept {
+    std::string buf;
+    inspect(buf);
+    return buf;
+}
+
+inline std::uint32_t object::hash() noexcept {
+    if(_flags & HASH_CACHED) {
+        return _hash;
+    }
+    std::uint64_t h;
+    switch(_type) {
+    case INTEGER_OBJ:
+        h = static_cast<std::uint64_t>(static_cast<integer*>(this)->value()) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 32;
+        break;
+    case BOOLEAN_OBJ:
+        h = static_cast<boolean*>(this)->value() ? 1231 : 1237;
+        break;
+    case STRING_OBJ:
+        h = 14695981039346656037ULL; // FNV-1a
+        for(unsigned char c : static_cast<string*>(this)->value()) {
+            h = (h ^ c) * 1099511628211ULL;
+        }
+        break;
+    default:
+        h = reinterpret_cast<std::uintptr_t>(this) >> 3;
+    }
+    _hash = static_cast<std::uint32_t>(h);
+    _flags |= HASH_CACHED;
+    return _hash;
+}
+
+/**
+ * Deletes obj as its concrete type, the header has no virtual destructor.
+ */
+inline void destroy(object* obj) noexcept {
+    switch(obj->type()) {
+    case INTEGER_OBJ:       delete static_cast<integer*>(obj); break;
+    case BOOLEAN_OBJ:       delete static_cast<boolean*>(obj); break;
+    case NULL_OBJ:          delete static_cast<null*>(obj); break;
+    case RETURN_VALUE_OBJ:  delete static_cast<return_value*>(obj); break;
+    case ERROR_OBJ:         delete static_cast<error*>(obj); break;
+    case FUNCTION_OBJ:      delete static_cast<function*>(obj); break;
+    case STRING_OBJ:        delete static_cast<string*>(obj); break;
+    case BUILTIN_OBJ:       delete static_cast<builtin*>(obj); break;
+    case ARRAY_OBJ:         delete static_cast<array*>(obj); break;
+    case FLAT_FUNCTION_OBJ: delete static_cast<flat_function*>(obj); break;
+    case HASH_OBJ:          delete static_cast<hash_map*>(obj); break;
+    case RANGE_OBJ:         delete static_cast<range*>(obj); break;
+    case SEQUENCE_OBJ:      delete static_cast<sequence*>(obj); break;
+    }
+}
+
+} // namespace object
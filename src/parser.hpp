@@ -5,6 +5,7 @@
 #include "lexer.hpp"
 #include "trace.hpp"
 #include <cstdint>
+#include <functional>
 #include <sstream>
 #include <string>
 #include <cassert>
@@ -15,15 +16,17 @@ namespace parser {
 using precedence = uint8_t;
 
 constexpr precedence LOWEST         = 0; // placeholder only
-constexpr precedence EQUALS         = 1; // ==
-constexpr precedence LESSGREATER    = 2; // < or >
-constexpr precedence SUM            = 3; // + 
-constexpr precedence PRODUCT        = 4; // *
-constexpr precedence PREFIX         = 5; // -var or !var
-constexpr precedence CALL           = 6; // my_fn(var)
-constexpr precedence INDEX          = 7; // array[index]
+constexpr precedence ASSIGNMENT     = 1; // x = value
+constexpr precedence EQUALS         = 2; // ==
+constexpr precedence LESSGREATER    = 3; // < or >
+constexpr precedence SUM            = 4; // + 
+constexpr precedence PRODUCT        = 5; // *
+constexpr precedence PREFIX         = 6; // -var or !var
+constexpr precedence CALL           = 7; // my_fn(var)
+constexpr precedence INDEX          = 8; // array[index]
 
 const std::unordered_map<token::token_t, precedence> precedences {
+    {token::ASSIGN,     ASSIGNMENT},
     {token::EQ,         EQUALS},
     {token::NEQ,        EQUALS},
     {token::LT,         LESSGREATER},
@@ -42,17 +45,14 @@ public:
     using infix_parse_fn_t = std::function<ast::expression*(ast::expression*)>;
 
     void next_token() noexcept {
-        _cur_token = _peek_token;
-        token::token _cur_token_assertion = _cur_token; // only for the assertion statement below
-        _peek_token = _l.next_token();
-
-        assert(_cur_token == _cur_token_assertion && "cur_token changed when next_token() is called");
+        if(_pos + 1 < _tokens.size()) {
+            ++_pos;
+        }
     }
 
-    parser(lexer::lexer l) noexcept : _l(l) {
-        next_token();
-        next_token(); // initialize both _cur and _peek tokens
+    parser(lexer::lexer l) noexcept : parser(l.tokenize()) {}
 
+    parser(lexer::token_buffer tokens) noexcept : _tokens(std::move(tokens)), _pos(0), _lines(_tokens.source()) {
         register_prefix_fn(token::IDENT,    [this]() -> ast::expression* { return this->parse_identifier(); });
         register_prefix_fn(token::INT,      [this]() -> ast::expression* { return this->parse_int_literal(); });
         register_prefix_fn(token::BANG,     [this]() -> ast::expression* { return this->parse_prefix_expr(); });
@@ -64,6 +64,7 @@ public:
         register_prefix_fn(token::FUNCTION, [this]() -> ast::expression* { return this->parse_function_literal(); });
         register_prefix_fn(token::STRING,   [this]() -> ast::expression* { return this->parse_string_literal(); });
         register_prefix_fn(token::LBRACKET, [this]() -> ast::expression* { return this->parse_array_literal(); });
+        register_prefix_fn(token::LBRACE,   [this]() -> ast::expression* { return this->parse_hash_literal(); });
 
         register_infix_fn(token::PLUS,      [this](ast::expression* a) -> ast::expression* { return this->parse_infix_expr(a); });
         register_infix_fn(token::MINUS,     [this](ast::expression* a) -> ast::expression* { return this->parse_infix_expr(a); });
@@ -75,12 +76,13 @@ public:
         register_infix_fn(token::GT,        [this](ast::expression* a) -> ast::expression* { return this->parse_infix_expr(a); });
         register_infix_fn(token::LPAREN,    [this](ast::expression* a) -> ast::expression* { return this->parse_call_expr(a); });
         register_infix_fn(token::LBRACKET,  [this](ast::expression* a) -> ast::expression* { return this->parse_index_expr(a); });
+        register_infix_fn(token::ASSIGN,    [this](ast::expression* a) -> ast::expression* { return this->parse_assign_expr(a); });
     }
 
     ast::program* parse_program() noexcept {
         ast::program* program = new ast::program();
  
-        while(_cur_token.get_type() != token::EOFT){
+        while(cur_type() != token::EOFT){
             std::unique_ptr<ast::statement> stmt(parse_statement());
             if(stmt){
                 program->add_statement(std::move(stmt));
@@ -91,27 +93,33 @@ public:
     }
 
     ast::statement* parse_statement() noexcept { 
-        switch(_cur_token.get_type()){
+        switch(cur_type()){
         case token::LET:
             return parse_let_statement();
             break;
         case token::RETURN:
             return parse_return_statement();
             break;
+        case token::WHILE:
+            return parse_while_statement();
+            break;
+        case token::FOR:
+            return parse_for_statement();
+            break;
         default:
             return parse_expr_statement();
         }
     }
 
     ast::let_statement* parse_let_statement() noexcept {
-        trace t("parse_let_stmt: " + std::string(_cur_token.token_literal()));
-        ast::let_statement* stmt = new ast::let_statement(_cur_token);
+        trace t("parse_let_stmt: " + std::string(cur_literal()));
+        ast::let_statement* stmt = new ast::let_statement(cur_span());
 
         if(!expect_peek(token::IDENT)){
             return nullptr;
         }
 
-        stmt->move_ident(ast::identifier(_cur_token, _cur_token.token_literal()));
+        stmt->move_ident(ast::identifier(cur_span(), cur_literal()));
         if(!expect_peek(token::ASSIGN)){
             return nullptr;
         }
@@ -125,8 +133,8 @@ public:
     }
 
     ast::return_statement* parse_return_statement() noexcept {
-        trace t("parse_return_stmt: " + std::string(_cur_token.token_literal()));
-        ast::return_statement* stmt = new ast::return_statement(_cur_token);
+        trace t("parse_return_stmt: " + std::string(cur_literal()));
+        ast::return_statement* stmt = new ast::return_statement(cur_span());
 
         next_token();
 
@@ -138,9 +146,62 @@ public:
         return stmt;
     }
 
+    ast::while_statement* parse_while_statement() noexcept {
+        trace t("parse_while_stmt: " + std::string(cur_literal()));
+        ast::while_statement* stmt = new ast::while_statement(cur_span());
+
+        if(!expect_peek(token::LPAREN)){
+            return nullptr;
+        }
+        next_token();
+        stmt->set_condition(parse_expr(LOWEST));
+
+        if(!expect_peek(token::RPAREN)) {
+            return nullptr;
+        }
+        if(!expect_peek(token::LBRACE)) {
+            return nullptr;
+        }
+        stmt->set_body(parse_block_statement());
+        if(peek_token_is(token::SEMICOLON)) {
+            next_token();
+        }
+        return stmt;
+    }
+
+    ast::for_statement* parse_for_statement() noexcept {
+        trace t("parse_for_stmt: " + std::string(cur_literal()));
+        ast::for_statement* stmt = new ast::for_statement(cur_span());
+
+        if(!expect_peek(token::LPAREN)){
+            return nullptr;
+        }
+        if(!expect_peek(token::IDENT)){
+            return nullptr;
+        }
+        stmt->move_ident(ast::identifier(cur_span(), cur_literal()));
+        if(!expect_peek(token::IN)){
+            return nullptr;
+        }
+        next_token();
+        stmt->set_iterable(parse_expr(LOWEST));
+
+        if(!expect_peek(token::RPAREN)) {
+            return nullptr;
+        }
+        if(!expect_peek(token::LBRACE)) {
+            return nullptr;
+        }
+        stmt->set_body(parse_block_statement());
+        if(peek_token_is(token::SEMICOLON)) {
+            next_token();
+        }
+        return stmt;
+    }
+
     ast::expression_statement* parse_expr_statement() noexcept {
-        trace t("parse_expr_statement: " + std::string(_cur_token.token_literal()));
-        ast::expression_statement* stmt = new ast::expression_statement(_cur_token);
+        trace t("parse_expr_statement: " + std::string(cur_literal()));
+        ast::expression_statement* stmt = new ast::expression_statement(cur_span());
          
         stmt->move_expr(parse_expr(LOWEST));
         
@@ -152,18 +213,18 @@ public:
     }
 
     ast::expression* parse_expr(precedence p) noexcept {
-        trace t("parse_expr: " + std::string(_cur_token.token_literal()));
-        prefix_parse_fn_t prefix_fn = _prefix_parse_fn_map[_cur_token.get_type()];
+        trace t("parse_expr: " + std::string(cur_literal()));
+        prefix_parse_fn_t prefix_fn = _prefix_parse_fn_map[cur_type()];
         
         if(prefix_fn == nullptr) {
-            _errors.push_back("no prefix parse function found for "+token::inv_map[_cur_token.get_type()]);
+            _errors.push_back("no prefix parse function found for "+token::inv_map[cur_type()]+location(_pos));
             return nullptr;
         }
 
         ast::expression* left_expr = prefix_fn();
 
         while(!peek_token_is(token::SEMICOLON) && p < peek_precedence()) {
-            infix_parse_fn_t infix_fn = _infix_parse_fn_map[_peek_token.get_type()];
+            infix_parse_fn_t infix_fn = _infix_parse_fn_map[peek_type()];
             if(infix_fn == nullptr) {
                 return left_expr;
             }
@@ -174,12 +235,29 @@ public:
     }
 
     ast::expression* parse_index_expr(ast::expression* left) noexcept {
-        trace t("parse_index_expr: " + std::string(_cur_token.token_literal()));
-        ast::index_expression* expr = new ast::index_expression(_cur_token, left);
+        trace t("parse_index_expr: " + std::string(cur_literal()));
+        token::span bracket = cur_span();
 
         next_token();
-        expr->set_index(parse_expr(LOWEST));
+        ast::expression* index = cur_token_is(token::COLON) ? nullptr : parse_expr(LOWEST);
+        if(index != nullptr && !peek_token_is(token::COLON)) {
+            ast::index_expression* expr = new ast::index_expression(bracket, left);
+            expr->set_index(index);
+            if(!expect_peek(token::RBRACKET)) {
+                return nullptr;
+            }
+            return expr;
+        }
 
+        // left[begin:end], either bound can be left out
+        if(index != nullptr) {
+            next_token();
+        }
+        ast::slice_expression* expr = new ast::slice_expression(bracket, left, index);
+        if(!peek_token_is(token::RBRACKET)) {
+            next_token();
+            expr->set_end(parse_expr(LOWEST));
+        }
         if(!expect_peek(token::RBRACKET)) {
             return nullptr;
         }
@@ -187,8 +265,21 @@ public:
         return expr;
     }
 
+    ast::expression* parse_assign_expr(ast::expression* target) noexcept {
+        trace t("parse_assign_expr: " + std::string(cur_literal()));
+        if(dynamic_cast<ast::identifier*>(target) == nullptr && dynamic_cast<ast::index_expression*>(target) == nullptr) {
+            _errors.push_back("cannot assign to " + (target != nullptr ? target->to_string() : std::string("nothing"))+location(_pos));
+        }
+        ast::assign_expression* expr = new ast::assign_expression(cur_span(), target);
+
+        // the value is parsed at the lowest precedence so that a = b = c nests to the right
+        next_token();
+        expr->set_value(parse_expr(LOWEST));
+        return expr;
+    }
+
     std::vector<ast::expression*> parse_expr_list(token::token_t end) noexcept {
-        trace t("parse_expr_list: " + std::string(_cur_token.token_literal()));
+        trace t("parse_expr_list: " + std::string(cur_literal()));
         std::vector<ast::expression*> list;
         if(peek_token_is(end)) {
             next_token();
@@ -212,47 +303,72 @@ public:
     }
 
     ast::expression* parse_identifier() const noexcept {
-        trace t("parse_ident: " + std::string(_cur_token.token_literal()));
-        ast::expression* ident = new ast::identifier(_cur_token, _cur_token.token_literal());
+        trace t("parse_ident: " + std::string(cur_literal()));
+        ast::expression* ident = new ast::identifier(cur_span(), cur_literal());
         return ident;
     }
 
     ast::expression* parse_boolean() const noexcept {
-        trace t("parse_boolean: " + std::string(_cur_token.token_literal()));
-        ast::expression* boolean = new ast::boolean(_cur_token, cur_token_is(token::TRUE));
+        trace t("parse_boolean: " + std::string(cur_literal()));
+        ast::expression* boolean = new ast::boolean(cur_span(), cur_token_is(token::TRUE));
         return boolean;
     }
 
     ast::expression* parse_int_literal() const {
-        trace t("parse_int_literal: " + std::string(_cur_token.token_literal()));
-        std::int64_t val = std::stoll(std::string(_cur_token.token_literal()));
-        ast::expression* lit = new ast::int_literal(_cur_token, val); 
+        trace t("parse_int_literal: " + std::string(cur_literal()));
+        std::int64_t val = std::stoll(std::string(cur_literal()));
+        ast::expression* lit = new ast::int_literal(cur_span(), val); 
         return lit;
     }
 
     ast::expression* parse_string_literal() const noexcept {
-        trace t("parse_str_literal: " + std::string(_cur_token.token_literal()));
-        ast::expression* string_lit = new ast::string_literal(_cur_token, _cur_token.token_literal());
+        trace t("parse_str_literal: " + std::string(cur_literal()));
+        ast::expression* string_lit = new ast::string_literal(cur_span(), cur_literal());
         return string_lit;
     }
 
     ast::expression* parse_array_literal() noexcept {
-        trace t("parse_array_literal: " + std::string(_cur_token.token_literal()));
-        ast::array_literal* array = new ast::array_literal(_cur_token);
+        trace t("parse_array_literal: " + std::string(cur_literal()));
+        ast::array_literal* array = new ast::array_literal(cur_span());
         array->set_elements(parse_expr_list(token::RBRACKET));
         return array;
     }
 
+    ast::expression* parse_hash_literal() noexcept {
+        trace t("parse_hash_literal: " + std::string(cur_literal()));
+        ast::hash_literal* hash = new ast::hash_literal(cur_span());
+        while(!peek_token_is(token::RBRACE)) {
+            next_token();
+            ast::expression* key = parse_expr(LOWEST);
+            if(!expect_peek(token::COLON)) {
+                delete key;
+                delete hash;
+                return nullptr;
+            }
+            next_token();
+            hash->add_pair(key, parse_expr(LOWEST));
+            if(!peek_token_is(token::RBRACE) && !expect_peek(token::COMMA)) {
+                delete hash;
+                return nullptr;
+            }
+        }
+        if(!expect_peek(token::RBRACE)) {
+            delete hash;
+            return nullptr;
+        }
+        return hash;
+    }
+
     ast::expression* parse_prefix_expr() noexcept {
-        trace t("parse_prefix_expr: " + std::string(_cur_token.token_literal()));
-        ast::prefix_expression* expr = new ast::prefix_expression(_cur_token, _cur_token.token_literal());
+        trace t("parse_prefix_expr: " + std::string(cur_literal()));
+        ast::prefix_expression* expr = new ast::prefix_expression(cur_span(), cur_literal());
         next_token();
         expr->set_expr(parse_expr(PREFIX));
         return expr;
     }
 
     ast::expression* parse_grouped_expr() noexcept {
-        trace t("parse_grouped_expr: " + std::string(_cur_token.token_literal()));
+        trace t("parse_grouped_expr: " + std::string(cur_literal()));
         next_token();
         ast::expression* exp = parse_expr(LOWEST);
 
@@ -263,8 +379,8 @@ public:
     }
 
     ast::expression* parse_if_expression() noexcept {
-        trace t("parse_if_expr: " + std::string(_cur_token.token_literal()));
-        ast::if_expression* expr = new ast::if_expression(_cur_token);
+        trace t("parse_if_expr: " + std::string(cur_literal()));
+        ast::if_expression* expr = new ast::if_expression(cur_span());
 
         if(!expect_peek(token::LPAREN)){
             return nullptr;
@@ -292,8 +408,8 @@ public:
     } 
 
     ast::block_statement* parse_block_statement() noexcept {
-        trace t("parse_block_statement: " + std::string(_cur_token.token_literal()));
-        ast::block_statement* block = new ast::block_statement();
+        trace t("parse_block_statement: " + std::string(cur_literal()));
+        ast::block_statement* block = new ast::block_statement(cur_span());
         next_token();
 
         while(!cur_token_is(token::RBRACE) && !cur_token_is(token::EOFT)) {
@@ -307,8 +423,8 @@ public:
     }
 
     ast::expression* parse_function_literal() noexcept {
-        trace t("parse_fn_literal: " + std::string(_cur_token.token_literal()));
-        ast::function_literal* fn = new ast::function_literal();
+        trace t("parse_fn_literal: " + std::string(cur_literal()));
+        ast::function_literal* fn = new ast::function_literal(cur_span());
 
         if(!expect_peek(token::LPAREN)){
             return nullptr;
@@ -326,7 +442,7 @@ public:
     }
 
     std::vector<ast::identifier*> parse_function_parameters() noexcept {
-        trace t("parse_fn_parameters: " + std::string(_cur_token.token_literal()));
+        trace t("parse_fn_parameters: " + std::string(cur_literal()));
         std::vector<ast::identifier*> identifiers;
         if(peek_token_is(token::RPAREN)) {
             next_token();
@@ -334,13 +450,13 @@ public:
         }
         next_token();
 
-        ast::identifier* ident = new ast::identifier(_cur_token, _cur_token.token_literal());
+        ast::identifier* ident = new ast::identifier(cur_span(), cur_literal());
         identifiers.push_back(ident);
 
         while(peek_token_is(token::COMMA)) {
             next_token();
             next_token();
-            ast::identifier* ident = new ast::identifier(_cur_token, _cur_token.token_literal());
+            ast::identifier* ident = new ast::identifier(cur_span(), cur_literal());
             identifiers.push_back(ident);
         }
 
@@ -352,9 +468,22 @@ public:
         return identifiers;
     }
 
-    bool cur_token_is(token::token_t token_type) const noexcept { return _cur_token.get_type() == token_type; }
+    token::token_t cur_type() const noexcept { return _tokens.type(_pos); }
+
+    /**
+     * Type of the token k positions ahead of the current one, EOFT past the end of input.
+     */
+    token::token_t peek_type(std::size_t k = 1) const noexcept {
+        std::size_t i = _pos + k;
+        return i < _tokens.size() ? _tokens.type(i) : token::EOFT;
+    }
 
-    bool peek_token_is(token::token_t token_type) const noexcept { return _peek_token.get_type() == token_type; }
+    std::string_view cur_literal() const noexcept { return _tokens.literal(_pos); }
+    token::span cur_span() const noexcept { return _tokens.span(_pos); }
+
+    bool cur_token_is(token::token_t token_type) const noexcept { return cur_type() == token_type; }
+
+    bool peek_token_is(token::token_t token_type) const noexcept { return peek_type() == token_type; }
 
     bool expect_peek(token::token_t token_type) noexcept {
         if(peek_token_is(token_type)){
@@ -373,11 +502,21 @@ public:
         oss << "expected next token to be " 
             << token::inv_map[token_type]
             << ", got " 
-            << token::inv_map[_peek_token.get_type()]
-            << " instead.";
+            << token::inv_map[peek_type()]
+            << " instead"
+            << location(std::min(_pos + 1, _tokens.size() - 1))
+            << ".";
         _errors.push_back(oss.str());
     }
 
+    /**
+     * Line and column of the i-th token, formatted for error messages.
+     */
+    std::string location(std::size_t i) noexcept {
+        lexer::line_table::position pos = _lines.locate(_tokens.offset(i));
+        return " at " + std::to_string(pos.line) + ":" + std::to_string(pos.column);
+    }
+
     void register_prefix_fn(token::token_t token_type, prefix_parse_fn_t prefix_parse_fn) noexcept {
         _prefix_parse_fn_map[token_type] = prefix_parse_fn;
     }
@@ -387,7 +526,7 @@ public:
     }
 
     const precedence peek_precedence() const noexcept {
-        auto p = precedences.find(_peek_token.get_type());
+        auto p = precedences.find(peek_type());
         if(p != precedences.end()) {
             return p->second;
         }
@@ -395,7 +534,7 @@ public:
     }
     
     const precedence cur_precedence() const noexcept {
-        auto p = precedences.find(_cur_token.get_type());
+        auto p = precedences.find(cur_type());
         if(p != precedences.end()) {
             return p->second;
         }
@@ -403,8 +542,8 @@ public:
     }
 
     ast::expression* parse_infix_expr(ast::expression* l_expr) noexcept {
-        trace t("parse_infix_expr: " + std::string(_cur_token.token_literal()));
-        ast::infix_expression* expr = new ast::infix_expression(_cur_token, _cur_token.token_literal(), l_expr);
+        trace t("parse_infix_expr: " + std::string(cur_literal()));
+        ast::infix_expression* expr = new ast::infix_expression(cur_span(), cur_literal(), l_expr);
 
         precedence cur_p = cur_precedence();
         next_token();
@@ -414,16 +553,16 @@ public:
     }
 
     ast::expression* parse_call_expr(ast::expression* function) noexcept {
-        trace t("parse_call_expr: " + std::string(_cur_token.token_literal()));
-        ast::call_expression* expr = new ast::call_expression(_cur_token, function);
+        trace t("parse_call_expr: " + std::string(cur_literal()));
+        ast::call_expression* expr = new ast::call_expression(cur_span(), function);
         expr->set_arguments(parse_expr_list(token::RPAREN));
         return expr;
     }
 
 protected:
-    lexer::lexer                _l;
-    token::token                _cur_token;
-    token::token                _peek_token;
+    lexer::token_buffer         _tokens;
+    std::size_t                 _pos; // index of the current token in _tokens
+    lexer::line_table           _lines;
     std::vector<std::string>    _errors;
 
     std::array<prefix_parse_fn_t, token::token_count>   _prefix_parse_fn_map;
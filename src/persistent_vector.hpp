@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace object {
+
+struct object;
+
+/**
+ * Immutable vector of objects as a 32-way trie with a tail, in the style of
+ * Clojure's PersistentVector. push() and set() return a new vector that shares
+ * all but O(log32 n) nodes with the original, at() walks at most
+ * log32 n levels.
+ *
+ * The tail leaf is filled in place by push() as long as no other vector has
+ * appended to it past this vector's end, so a chain of pushes copies nothing
+ * until a tail is full. Vectors only read the tail up to their own length, so
+ * this is invisible to the vectors that share it.
+ */
+class persistent_vector {
+public:
+    static constexpr std::uint32_t bits = 5;
+    static constexpr std::uint32_t width = 1 << bits;
+    static constexpr std::uint32_t mask = width - 1;
+
+    persistent_vector() noexcept : _tail(std::make_shared<leaf>()) {}
+
+    std::size_t size() const noexcept { return _count; }
+
+    object* at(std::size_t i) const noexcept {
+        if(i >= tail_offset()) {
+            return _tail->items[i - tail_offset()];
+        }
+        const void* n = _root.get();
+        for(std::uint32_t level = _shift; level > 0; level -= bits) {
+            n = static_cast<const branch*>(n)->children[(i >> level) & mask].get();
+        }
+        return static_cast<const leaf*>(n)->items[i & mask];
+    }
+
+    persistent_vector push(object* val) const noexcept {
+        persistent_vector res = *this;
+        ++res._count;
+        std::uint32_t tail_size = _count - tail_offset();
+        if(tail_size < width) {
+            if(_tail->used != tail_size) {
+                // another vector has appended to the shared tail, continue in a copy
+                res._tail = std::make_shared<leaf>(*_tail);
+            }
+            res._tail->items[tail_size] = val;
+            res._tail->used = tail_size + 1;
+            return res;
+        }
+        // the tail is full, it moves into the trie
+        if((_count >> bits) > (std::size_t(1) << _shift)) {
+            auto root = std::make_shared<branch>();
+            root->children[0] = _root;
+            root->children[1] = new_path(_shift, _tail);
+            res._root = std::move(root);
+            res._shift += bits;
+        } else {
+            res._root = push_tail(_shift, _root.get(), _tail);
+        }
+        res._tail = std::make_shared<leaf>();
+        res._tail->items[0] = val;
+        res._tail->used = 1;
+        return res;
+    }
+
+    /**
+     * A vector with element i replaced by val, i must be in range.
+     */
+    persistent_vector set(std::size_t i, object* val) const noexcept {
+        persistent_vector res = *this;
+        if(i >= tail_offset()) {
+            res._tail = std::make_shared<leaf>(*_tail);
+            res._tail->items[i - tail_offset()] = val;
+            res._tail->used = _count - tail_offset();
+            return res;
+        }
+        res._root = assoc(_shift, _root.get(), i, val);
+        return res;
+    }
+
+private:
+    struct leaf {
+        std::uint32_t   used = 0;   // slots written by any vector sharing this tail
+        object*         items[width];
+    };
+
+    struct branch {
+        std::shared_ptr<const void>     children[width];    // branches, or leaves on the last level
+    };
+
+    std::size_t tail_offset() const noexcept {
+        return _count < width ? 0 : ((_count - 1) >> bits) << bits;
+    }
+
+    static std::shared_ptr<const void> new_path(std::uint32_t level, std::shared_ptr<const void> n) noexcept {
+        if(level == 0) {
+            return n;
+        }
+        auto res = std::make_shared<branch>();
+        res->children[0] = new_path(level - bits, std::move(n));
+        return res;
+    }
+
+    std::shared_ptr<const void> push_tail(std::uint32_t level, const void* parent, std::shared_ptr<const void> tail) const noexcept {
+        auto res = parent != nullptr ? std::make_shared<branch>(*static_cast<const branch*>(parent)) : std::make_shared<branch>();
+        std::size_t sub = ((_count - 1) >> level) & mask;
+        if(level == bits) {
+            res->children[sub] = std::move(tail);
+        } else if(res->children[sub] != nullptr) {
+            res->children[sub] = push_tail(level - bits, res->children[sub].get(), std::move(tail));
+        } else {
+            res->children[sub] = new_path(level - bits, std::move(tail));
+        }
+        return res;
+    }
+
+    static std::shared_ptr<const void> assoc(std::uint32_t level, const void* n, std::size_t i, object* val) noexcept {
+        if(level == 0) {
+            auto res = std::make_shared<leaf>(*static_cast<const leaf*>(n));
+            res->items[i & mask] = val;
+            return res;
+        }
+        auto res = std::make_shared<branch>(*static_cast<const branch*>(n));
+        std::size_t sub = (i >> level) & mask;
+        res->children[sub] = assoc(level - bits, res->children[sub].get(), i, val);
+        return res;
+    }
+
+    std::size_t                     _count = 0;
+    std::uint32_t                   _shift = bits;
+    std::shared_ptr<const void>     _root;
+    std::shared_ptr<leaf>           _tail;
+};
+
+} // namespace object
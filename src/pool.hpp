@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace object {
+
+/**
+ * Size-class allocator for runtime objects and scopes. Requests are rounded up
+ * to a multiple of 16 bytes. A freed block goes onto the free list of its class,
+ * and new blocks are bumped out of the current slab. Requests larger than the
+ * biggest class go to the global operator new.
+ *
+ * Each thread has its own pool (see local()), so no locking is needed. A block
+ * must be freed on the thread that allocated it, and must not outlive that
+ * thread, since the slabs are released when the pool is destroyed.
+ */
+class pool {
+public:
+    static constexpr std::size_t granularity = 16;
+    static constexpr std::size_t max_block = 256;
+    static constexpr std::size_t class_count = max_block / granularity;
+    static constexpr std::size_t slab_size = 64 * 1024;
+
+    struct stats {
+        std::size_t live = 0;       // blocks handed out and not yet freed
+        std::size_t free = 0;       // freed blocks waiting on a free list
+        std::size_t slabs = 0;      // slabs reserved so far
+        std::size_t oversized = 0;  // live blocks that went to the global allocator
+    };
+
+    pool() noexcept = default;
+    pool(const pool&) = delete;
+    pool& operator=(const pool&) = delete;
+
+    ~pool() noexcept {
+        for(void* slab : _slabs) {
+            ::operator delete(slab);
+        }
+    }
+
+    /**
+     * The calling thread's pool.
+     */
+    static pool& local() noexcept {
+        thread_local pool p;
+        return p;
+    }
+
+    void* allocate(std::size_t size) {
+        if(size > max_block) {
+            ++_oversized;
+            return ::operator new(size);
+        }
+        size_class& sc = _classes[class_of(size)];
+        ++sc.live;
+        if(sc.free_list != nullptr) {
+            block* b = sc.free_list;
+            sc.free_list = b->next;
+            --sc.free;
+            return b;
+        }
+        std::size_t bytes = block_size(size);
+        if(_cursor == nullptr || static_cast<std::size_t>(_end - _cursor) < bytes) {
+            refill();
+        }
+        void* p = _cursor;
+        _cursor += bytes;
+        return p;
+    }
+
+    void deallocate(void* p, std::size_t size) noexcept {
+        if(p == nullptr) {
+            return;
+        }
+        if(size > max_block) {
+            --_oversized;
+            ::operator delete(p);
+            return;
+        }
+        size_class& sc = _classes[class_of(size)];
+        block* b = static_cast<block*>(p);
+        b->next = sc.free_list;
+        sc.free_list = b;
+        --sc.live;
+        ++sc.free;
+    }
+
+    /**
+     * Totals over all size classes.
+     */
+    stats totals() const noexcept {
+        stats res;
+        for(const size_class& sc : _classes) {
+            res.live += sc.live;
+            res.free += sc.free;
+        }
+        res.slabs = _slabs.size();
+        res.oversized = _oversized;
+        return res;
+    }
+
+    /**
+     * Statistics of the size class that serves requests of size bytes.
+     */
+    stats size_class_of(std::size_t size) const noexcept {
+        stats res;
+        if(size > max_block) {
+            res.oversized = _oversized;
+        } else {
+            res.live = _classes[class_of(size)].live;
+            res.free = _classes[class_of(size)].free;
+        }
+        res.slabs = _slabs.size();
+        return res;
+    }
+
+    static constexpr std::size_t block_size(std::size_t size) noexcept {
+        return (class_of(size) + 1) * granularity;
+    }
+
+private:
+    struct block {
+        block* next;
+    };
+
+    struct size_class {
+        block*          free_list = nullptr;
+        std::size_t     live = 0;
+        std::size_t     free = 0;
+    };
+
+    static constexpr std::size_t class_of(std::size_t size) noexcept {
+        return size == 0 ? 0 : (size - 1) / granularity;
+    }
+
+    void refill() {
+        _cursor = static_cast<char*>(::operator new(slab_size));
+        _end = _cursor + slab_size;
+        _slabs.push_back(_cursor);
+    }
+
+    std::array<size_class, class_count>     _classes;
+    std::vector<void*>                      _slabs;
+    char*                                   _cursor = nullptr;
+    char*                                   _end = nullptr;
+    std::size_t                             _oversized = 0;
+};
+
+} // namespace object
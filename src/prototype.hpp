@@ -0,0 +1,40 @@
+#pragma once
+
+#include "ast.hpp"
+#include "escape_analysis.hpp"
+#include "free_variables.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ast {
+
+/**
+ * Immutable, per-literal part of a function, built once on the first evaluation
+ * of the literal and shared by every closure created from it.
+ */
+struct prototype {
+    std::vector<std::shared_ptr<identifier>>    parameters;
+    std::size_t                                 arity;
+    std::size_t                                 slots;          // parameters plus distinct let bindings of the body
+    std::shared_ptr<const block_statement>      body;
+    std::vector<std::string>                    free_variables; // names read from enclosing scopes
+    bool                                        frame_escapes;  // whether a call frame can outlive the call
+
+    static const std::shared_ptr<const prototype>& of(const function_literal& fn) noexcept {
+        if(fn.cached_prototype() == nullptr) {
+            auto proto = std::make_shared<prototype>();
+            std::vector<std::string> locals;
+            proto->parameters = fn.parameters();
+            proto->arity = fn.parameters().size();
+            proto->body = fn.body();
+            proto->free_variables = free_variables::of(fn, &locals);
+            proto->slots = proto->arity + locals.size();
+            proto->frame_escapes = escape_analysis::frame_escapes(fn);
+            fn.set_prototype(std::move(proto));
+        }
+        return fn.cached_prototype();
+    }
+};
+
+} // namespace ast
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace object {
+
+/**
+ * Open-addressing hash table in the style of Abseil's SwissTable. Every slot
+ * has a control byte, either empty or the low 7 bits of the hash of the key in
+ * it. A lookup probes a group of 16 control bytes at once and only compares
+ * keys whose 7 bits match, so a probe rarely touches more than one key. Groups
+ * are probed triangularly, which visits every group of a power of two table.
+ *
+ * Entries live in a dense vector in insertion order with their hash, slots
+ * hold an index into it. Iteration is in insertion order and growing the
+ * table re-slots the entries without hashing keys again. Entries are never
+ * removed.
+ */
+template <typename Key, typename Value, typename Hash, typename Equal>
+class swiss_table {
+public:
+    static constexpr std::size_t group_width = 16;
+    static constexpr std::size_t npos = ~std::size_t(0);
+
+    struct entry {
+        Key             key;
+        Value           value;
+        std::uint32_t   hash;
+    };
+
+    std::size_t size() const noexcept { return _entries.size(); }
+    std::size_t capacity() const noexcept { return _slots.size(); }
+    const std::vector<entry>& entries() const noexcept { return _entries; }
+
+    /**
+     * The value for key, nullptr if there is none.
+     */
+    Value* find(const Key& key) noexcept {
+        std::size_t i = find_entry(key, Hash{}(key));
+        return i == npos ? nullptr : &_entries[i].value;
+    }
+
+    /**
+     * Binds key to value, returns false if key was bound already and its value
+     * was replaced.
+     */
+    bool insert(const Key& key, const Value& value) noexcept {
+        std::uint32_t h = Hash{}(key);
+        std::size_t i = find_entry(key, h);
+        if(i != npos) {
+            _entries[i].value = value;
+            return false;
+        }
+        // at most 7/8 full, so every probe sequence ends at an empty byte
+        if((_entries.size() + 1) * 8 > capacity() * 7) {
+            rehash(capacity() == 0 ? group_width : capacity() * 2);
+        }
+        place(_entries.size(), h);
+        _entries.push_back(entry{key, value, h});
+        return true;
+    }
+
+    /**
+     * Sizes the table for n entries without growing on the way.
+     */
+    void reserve(std::size_t n) noexcept {
+        std::size_t cap = group_width;
+        while(n * 8 > cap * 7) {
+            cap *= 2;
+        }
+        if(cap > capacity()) {
+            rehash(cap);
+        }
+        _entries.reserve(n);
+    }
+
+private:
+    static constexpr std::int8_t empty = -128;
+
+    static std::uint8_t h2(std::uint32_t hash) noexcept { return hash & 0x7f; }
+    std::size_t h1(std::uint32_t hash) const noexcept { return (hash >> 7) & (capacity() - 1); }
+
+    /**
+     * Bit i is set if control byte pos + i is b.
+     */
+    std::uint32_t match(std::size_t pos, std::int8_t b) const noexcept {
+#if defined(__SSE2__)
+        __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_ctrl.data() + pos));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(b)));
+#else
+        std::uint32_t res = 0;
+        for(std::size_t i = 0; i < group_width; i++) {
+            res |= std::uint32_t(_ctrl[pos + i] == b) << i;
+        }
+        return res;
+#endif
+    }
+
+    std::size_t find_entry(const Key& key, std::uint32_t hash) const noexcept {
+        if(capacity() == 0) {
+            return npos;
+        }
+        std::size_t mask = capacity() - 1;
+        std::size_t pos = h1(hash);
+        for(std::size_t step = group_width; ; step += group_width) {
+            for(std::uint32_t bits = match(pos, h2(hash)); bits != 0; bits &= bits - 1) {
+                std::uint32_t i = _slots[(pos + std::countr_zero(bits)) & mask];
+                if(_entries[i].hash == hash && Equal{}(_entries[i].key, key)) {
+                    return i;
+                }
+            }
+            if(match(pos, empty) != 0) {
+                return npos;
+            }
+            pos = (pos + step) & mask;
+        }
+    }
+
+    void place(std::size_t index, std::uint32_t hash) noexcept {
+        std::size_t mask = capacity() - 1;
+        std::size_t pos = h1(hash);
+        for(std::size_t step = group_width; ; step += group_width) {
+            if(std::uint32_t bits = match(pos, empty)) {
+                std::size_t slot = (pos + std::countr_zero(bits)) & mask;
+                _slots[slot] = static_cast<std::uint32_t>(index);
+                _ctrl[slot] = h2(hash);
+                if(slot < group_width) {
+                    // the first group is mirrored past the end so groups never wrap
+                    _ctrl[capacity() + slot] = h2(hash);
+                }
+                return;
+            }
+            pos = (pos + step) & mask;
+        }
+    }
+
+    void rehash(std::size_t cap) noexcept {
+        _slots.assign(cap, 0);
+        _ctrl.assign(cap + group_width, empty);
+        for(std::size_t i = 0; i < _entries.size(); i++) {
+            place(i, _entries[i].hash);
+        }
+    }
+
+    std::vector<entry>          _entries;
+    std::vector<std::uint32_t>  _slots;
+    std::vector<std::int8_t>    _ctrl;
+};
+
+} // namespace object
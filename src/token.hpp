@@ -8,7 +8,7 @@
 namespace token { 
 
 using token_t = std::uint8_t;
-constexpr size_t token_count = 30;
+constexpr size_t token_count = 34;
 
 constexpr token_t ILLEGAL   = 0;
 constexpr token_t EOFT      = 1;
@@ -48,6 +48,12 @@ constexpr token_t STRING    = 27;
 constexpr token_t LBRACKET  = 28;
 constexpr token_t RBRACKET  = 29;
 
+constexpr token_t WHILE     = 30;
+constexpr token_t FOR       = 31;
+constexpr token_t IN        = 32;
+
+constexpr token_t COLON     = 33;
+
 const std::unordered_map<std::string_view, token_t> keywords {
     {"fn", FUNCTION},
     {"let", LET},
@@ -56,6 +62,9 @@ const std::unordered_map<std::string_view, token_t> keywords {
     {"if", IF},
     {"else", ELSE},
     {"return", RETURN},
+    {"while", WHILE},
+    {"for", FOR},
+    {"in", IN},
 }; 
 
 const std::array<std::string, token_count> inv_map {
@@ -66,16 +75,28 @@ const std::array<std::string, token_count> inv_map {
     "LPAREN", "RPAREN", "LBRACE", "RBRACE",
     "FUNCTION", "LET", "TRUE", "FALSE", "IF", "ELSE", "RETURN", 
     "STRING",
-    "LBRACKET", "RBRACKET"
+    "LBRACKET", "RBRACKET",
+    "WHILE", "FOR", "IN",
+    "COLON"
+};
+
+/**
+ * Location of a token or ast node in the source, as a byte offset and length.
+ */
+struct span {
+    std::uint32_t offset = 0;
+    std::uint32_t length = 0;
 };
 
 class token {
 public: 
     token() = default;
-    token(const token& other) noexcept : _type(other.get_type()), _literal(other.token_literal()) {}
+    token(const token& other) noexcept 
+        : _type(other.get_type()), _literal(other.token_literal()), _span(other.span()) {}
     token(token_t t, const char* lit) noexcept : _type(t), _literal(lit) {};
     token(token_t t, std::string lit) noexcept : _type(t), _literal(lit) {};
     token(token_t t, std::string_view lit) noexcept : _type(t), _literal(std::string(lit)) {};
+    token(token_t t, std::string_view lit, struct span s) noexcept : _type(t), _literal(std::string(lit)), _span(s) {};
 
     void set(token_t t, const char* lit) noexcept { _type = t; _literal = lit; }
     void set(token_t t, std::string lit) noexcept { _type = t; _literal = lit; }
@@ -85,10 +106,12 @@ public:
 
     const std::string_view token_literal() const noexcept { return _literal; }
     const token_t get_type() const noexcept { return _type; }
+    const struct span& span() const noexcept { return _span; }
 
 private:
     token_t     _type;
     std::string _literal;
+    struct span _span;
 };
 
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <iostream>
 
 namespace parser {
@@ -13,6 +15,22 @@ public:
             ++_indent_level;
         }
     };
+
+    /**
+     * Only prints the node when tracing is enabled, so that untraced evaluation
+     * doesn't pay for writing out the tree.
+     */
+    template <typename Node>
+    trace(std::string_view prefix, const Node& node) 
+        : trace(_enable_trace ? std::string(prefix) + node.to_string() : std::string()) {}
+
+    /**
+     * Only calls describe when tracing is enabled, for names that print runtime
+     * values and would otherwise cost a formatting pass on every evaluation.
+     */
+    template <typename Describe> requires std::is_invocable_r_v<std::string, Describe>
+    trace(Describe&& describe) : trace(_enable_trace ? describe() : std::string()) {}
+
     ~trace() {
         if(_enable_trace) {
             --_indent_level;
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace utf8 {
+
+struct info {
+    bool            valid = true;   // well-formed UTF-8: no overlongs, surrogates or truncated sequences
+    std::size_t     code_points = 0;
+};
+
+/**
+ * Length of the sequence started by lead, 0 if lead cannot start one.
+ */
+inline std::size_t sequence_length(unsigned char lead) noexcept {
+    if(lead < 0x80) {
+        return 1;
+    }
+    if(lead >= 0xc2 && lead <= 0xdf) {
+        return 2;
+    }
+    if(lead >= 0xe0 && lead <= 0xef) {
+        return 3;
+    }
+    if(lead >= 0xf0 && lead <= 0xf4) {
+        return 4;
+    }
+    return 0;
+}
+
+/**
+ * Validates the sequence at s[i], returns its length or 0 if it is malformed.
+ */
+inline std::size_t validate_sequence(std::string_view s, std::size_t i) noexcept {
+    unsigned char lead = s[i];
+    std::size_t n = sequence_length(lead);
+    if(n <= 1 || i + n > s.size()) {
+        return n == 1 ? 1 : 0;
+    }
+    unsigned char second = s[i + 1];
+    // the second byte range excludes overlongs, surrogates and code points above U+10FFFF
+    unsigned char lo = lead == 0xe0 ? 0xa0 : lead == 0xf0 ? 0x90 : 0x80;
+    unsigned char hi = lead == 0xed ? 0x9f : lead == 0xf4 ? 0x8f : 0xbf;
+    if(second < lo || second > hi) {
+        return 0;
+    }
+    for(std::size_t k = 2; k < n; k++) {
+        if((static_cast<unsigned char>(s[i + k]) & 0xc0) != 0x80) {
+            return 0;
+        }
+    }
+    return n;
+}
+
+/**
+ * Validates s and counts its code points. With SSE2, 16 bytes are handled per
+ * step: a block without high bits is all ASCII and counted whole, other blocks
+ * are validated sequence by sequence. A sequence that straddles two blocks is
+ * finished before the next block starts.
+ */
+inline info scan(std::string_view s) noexcept {
+    info res;
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    while(i + 16 <= s.size()) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s.data() + i));
+        if(_mm_movemask_epi8(block) == 0) {
+            res.code_points += 16;
+            i += 16;
+            continue;
+        }
+        std::size_t end = i + 16;
+        while(i < end) {
+            std::size_t n = validate_sequence(s, i);
+            if(n == 0) {
+                res.valid = false;
+                n = 1;
+            }
+            ++res.code_points;
+            i += n;
+        }
+    }
+#endif
+    while(i < s.size()) {
+        std::size_t n = validate_sequence(s, i);
+        if(n == 0) {
+            res.valid = false;
+            n = 1;
+        }
+        ++res.code_points;
+        i += n;
+    }
+    return res;
+}
+
+/**
+ * Byte offset of code point index in the valid UTF-8 string s, s.size() if
+ * index is past the end.
+ */
+inline std::size_t offset(std::string_view s, std::size_t index) noexcept {
+    std::size_t i = 0;
+    while(index > 0 && i < s.size()) {
+        i += sequence_length(static_cast<unsigned char>(s[i]));
+        --index;
+    }
+    return i < s.size() ? i : s.size();
+}
+
+} // namespace utf8
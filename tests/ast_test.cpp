@@ -2,14 +2,17 @@
 #include <iostream>
 #include "../src/ast.hpp"
 #include "../src/token.hpp"
+#include "../src/parser.hpp"
+#include "../src/hash_cons.hpp"
+#include "../src/inliner.hpp"
 
 namespace ast {
 
 void test_to_string() {
     program p;
-    let_statement* ls = new let_statement(token::token(token::LET, "let"));
-    ls->move_ident(identifier(token::token(token::IDENT, "my_var"), "my_var"));
-    identifier* expr = new identifier(token::token(token::IDENT, "another_var"), "another_var");
+    let_statement* ls = new let_statement(token::span{0, 3});
+    ls->move_ident(identifier(token::span{4, 6}, "my_var"));
+    identifier* expr = new identifier(token::span{13, 11}, "another_var");
     ls->set_value(expr);
     p.add_statement(ls);
 
@@ -20,12 +23,145 @@ void test_to_string() {
     std::cout<<"1 - ok: let_statement to_string ok."<<std::endl;
 }
 
+void test_pretty_print() {
+    const char* input = R"(let f = fn(x, y) { if (x < y) { return x; } else { "y" } }; f(1, 2 * 3);)";
+    lexer::lexer l(input);
+    parser::parser p(l);
+    std::unique_ptr<program> prog(p.parse_program());
+
+    std::string expected_compact = "let f = fn(x,y,)if(x < y) return x;else y;f(1, (2 * 3))";
+    if(prog->to_string() != expected_compact){
+        std::cout<<"program to_string() wrong. got "<<prog->to_string()<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::string expected_pretty = 
+        "let f = fn(x, y) {\n"
+        "    if(x < y) {\n"
+        "        return x;\n"
+        "    } else {\n"
+        "        \"y\";\n"
+        "    };\n"
+        "};\n"
+        "f(1, (2 * 3));";
+    if(prog->to_string(true) != expected_pretty){
+        std::cout<<"program pretty to_string() wrong. got "<<std::endl<<prog->to_string(true)<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    writer w;
+    for(const auto& stmt : prog->statements()) {
+        stmt->write(w);
+    }
+    if(w.str() != expected_compact){
+        std::cout<<"writer output wrong. got "<<w.str()<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout<<"2 - ok: pretty printing ok."<<std::endl;
+}
+
+void test_hash_consing() {
+    const char* input = R"(
+        let f = fn(x) { x * (x + 1) };
+        let g = fn(x) { x * (x + 1) };
+        let h = fn(y) { y * (y + 1) };
+        [f(2 + 3), g(2 + 3), 2 + 3];
+    )";
+    lexer::lexer l(input);
+    parser::parser p(l);
+    std::unique_ptr<program> prog(p.parse_program());
+    std::string before = prog->to_string();
+
+    hash_consing::report r = hash_consing().run(*prog);
+    if(prog->to_string() != before){
+        std::cout<<"program changed by hash-consing. got "<<prog->to_string()<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    auto value_of = [&](int i) {
+        return std::dynamic_pointer_cast<const let_statement>(prog->statements()[i])->value();
+    };
+    if(value_of(0) != value_of(1) || value_of(0) == value_of(2)){
+        std::cout<<"identical function literals not shared"<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+    auto expr = std::dynamic_pointer_cast<const expression_statement>(prog->statements()[3])->expr();
+    auto elements = std::dynamic_pointer_cast<const array_literal>(expr)->elements();
+    auto arg = std::dynamic_pointer_cast<const call_expression>(elements[0])->arguments()[0];
+    if(arg != elements[2]){
+        std::cout<<"identical infix expressions not shared"<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if(r.shared == 0 || r.bytes_saved == 0 || r.shared >= r.nodes){
+        std::cout<<"unexpected hash-consing report: "<<r.shared<<" of "<<r.nodes<<", "<<r.bytes_saved<<" bytes"<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // calls, statements and operators over calls stay distinct
+    lexer::lexer l2("let a = f(1); let a = f(1); [f(1) + 1, f(1) + 1, -x, -x];");
+    parser::parser p2(l2);
+    std::unique_ptr<program> impure(p2.parse_program());
+    hash_consing().run(*impure);
+    auto let_of = [&](int i) { return std::dynamic_pointer_cast<const let_statement>(impure->statements()[i]); };
+    auto items = std::dynamic_pointer_cast<const array_literal>(
+        std::dynamic_pointer_cast<const expression_statement>(impure->statements()[2])->expr())->elements();
+    if(let_of(0) == let_of(1) || let_of(0)->value() == let_of(1)->value() || items[0] == items[1] || items[2] != items[3]){
+        std::cout<<"hash-consing shared a mutable subtree, or missed a pure one"<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout<<"3 - ok: hash-consing ok."<<std::endl;
+}
+
+void test_inliner() {
+    const char* input = R"(
+        sq(2);
+        let sq = fn(x) { x * x };
+        let limit = 10;
+        let big = fn(x) { if (x > limit) { x } else { limit } };
+        let late = fn(x) { x + later };
+        let later = 1;
+        let fact = fn(n) { if (n < 2) { 1 } else { n * fact(n - 1) } };
+        sq(3) + sq(y) + big(limit) + sq(1 + 2) + fact(3) + late(1);
+    )";
+    lexer::lexer l(input);
+    parser::parser p(l);
+    std::unique_ptr<program> prog(p.parse_program());
+
+    inliner::report r = inliner().run(*prog);
+    std::string expected = "((((((3 * 3) + sq(y)) + if(limit > limit) limitelse limit) + sq((1 + 2))) + fact(3)) + late(1))";
+    if(prog->statements()[0]->to_string() != "sq(2)" || prog->statements()[7]->to_string() != expected){
+        std::cout<<"unexpected inlined program. got "<<prog->to_string()<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if(r.candidates != 2 || r.inlined != 2 || r.skipped != 2 || r.functions.size() != 2){
+        std::cout<<"unexpected inliner report: "<<r.candidates<<" candidates, "<<r.inlined<<" inlined, "<<r.skipped<<" skipped"<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // f is also bound as a parameter of g, so a call to f may mean something else
+    lexer::lexer l2("let f = fn(x) { x }; let g = fn(f) { f(1) }; f(1);");
+    parser::parser p2(l2);
+    std::unique_ptr<program> rebound(p2.parse_program());
+    r = inliner().run(*rebound);
+    if(r.candidates != 1 || r.inlined != 0){
+        std::cout<<"rebound helper inlined: "<<rebound->to_string()<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout<<"4 - ok: inliner ok."<<std::endl;
+}
+
 } // namespace ast 
 
+size_t parser::trace::_indent_level = 0;
+bool parser::trace::_enable_trace = 0;
+
 int main() {
     std::cout<<"Running ast_test.cpp..."<<std::endl;
     
     ast::test_to_string();
+    ast::test_pretty_print();
+    ast::test_hash_consing();
+    ast::test_inliner();
 
     std::cout<<"ast_test.cpp: ok"<<std::endl;
 
@@ -1,6 +1,8 @@
 #include "../src/evaluator.hpp"
 #include "../src/object.hpp"
 #include "../src/parser.hpp"
+#include "../src/hash_cons.hpp"
+#include "../src/inliner.hpp"
 #include <cstdlib>
 #include <optional>
 
@@ -14,7 +16,7 @@ template <typename T> struct test_case_base {
 
 template <typename To, typename From>
 To try_cast(From from, std::string err_msg) {
-  To casted = dynamic_cast<To>(from);
+  To casted = object::as<std::remove_cv_t<std::remove_pointer_t<To>>>(from);
   if (casted == nullptr) {
     std::cout << "fail: " << err_msg << std::endl;
     exit(EXIT_FAILURE);
@@ -323,9 +325,9 @@ void test_array_literal() {
   object::array* array = try_cast<object::array*>(evaluated, "test_array_lit - not an array obj.");
   assert_value(array->elements().size(), 3, "test_array_lit - array size");
 
-  test_integer_object(array->elements()[0].get(), 1);
-  test_integer_object(array->elements()[1].get(), 4);
-  test_integer_object(array->elements()[2].get(), 6);
+  test_integer_object(array->elements()[0], 1);
+  test_integer_object(array->elements()[1], 4);
+  test_integer_object(array->elements()[2], 6);
 
   std::cout << "15 - ok: array literals." << std::endl;
 }
@@ -356,6 +358,757 @@ void test_array_index_expression() {
   std::cout << "16 - ok: array index expressions." << std::endl; 
 }
 
+void test_hash_consed_program() {
+  const char *input = R"(
+    let double = fn(x) { x * 2 };
+    let twice = fn(x) { x * 2 };
+    double(3) + twice(4) + double(3);
+  )";
+  lexer::lexer l(input);
+  parser::parser p(l);
+  std::shared_ptr<ast::program> program(p.parse_program());
+  ast::hash_consing().run(*program);
+
+  test_integer_object(evaluator::eval(program, new object::scope()), 20);
+  std::cout << "17 - ok: evaluate hash-consed program." << std::endl;
+}
+
+void test_object_header() {
+  assert_value(sizeof(object::object), 8, "test_object_header - header size");
+
+  const object::object *truthy = test_eval("if (5 > 1) { true }");
+  assert_value(truthy->inspect(), "true", "test_object_header - boolean inspect");
+  test_null_object(test_eval("if ([1][3]) { 10 }"));
+  test_integer_object(test_eval("if ([1][0]) { 10 }"), 10);
+
+  const object::object *arr = test_eval("[1, [true, \"a\"]]");
+  assert_value(arr->inspect(), "[1, [true, a]]", "test_object_header - array inspect");
+  assert_value(object::as<object::integer>(arr) == nullptr, true, "test_object_header - checked downcast");
+
+  object::object *a = new object::integer(42), *b = new object::integer(42);
+  assert_value(a->hash(), b->hash(), "test_object_header - value hash");
+  object::destroy(a);
+  object::destroy(b);
+  std::cout << "18 - ok: compact object header." << std::endl;
+}
+
+void test_frame_escape() {
+  const char *escaping = R"(
+    let adder = fn(a) { fn(b) { a + b } };
+    let addtwo = adder(2);
+    let addthree = adder(3);
+    addtwo(1) + addthree(1);
+  )";
+  test_integer_object(test_eval(escaping), 7);
+
+  std::size_t before = frame_region::local().free_frames();
+  const char *local = R"(
+    let sq = fn(x) { let y = x * x; y };
+    let sum = fn(a, b) { sq(a) + sq(b) };
+    sum(2, 3) + sum(sq(1), 4) + sq(5);
+  )";
+  test_integer_object(test_eval(local), 13 + 17 + 25);
+  // nested calls need at most two frames at a time, every later call reuses them
+  assert_value(frame_region::local().free_frames(), std::max<std::size_t>(before, 2), "test_frame_escape - recycled frames");
+
+  lexer::lexer l("fn(x) { x }; fn(x) { let f = fn() { x }; 1 };");
+  parser::parser p(l);
+  std::shared_ptr<ast::program> program(p.parse_program());
+  auto literal = [&](int i) {
+    auto es = std::dynamic_pointer_cast<ast::expression_statement>(program->statements()[i]);
+    return std::dynamic_pointer_cast<const ast::function_literal>(es->expr());
+  };
+  assert_value(ast::escape_analysis::frame_escapes(*literal(0)), false, "test_frame_escape - plain body");
+  assert_value(ast::escape_analysis::frame_escapes(*literal(1)), true, "test_frame_escape - nested literal");
+  std::cout << "19 - ok: frames of non-escaping calls are recycled." << std::endl;
+}
+
+void test_closure_captures() {
+  const char *input = R"(
+    let a = 1; let b = 2; let unused = 3;
+    let f = fn(x) { let g = fn(y) { x + y + b }; g(a) + len("") };
+    f;
+  )";
+  object::function *fn = try_cast<object::function *>(
+      const_cast<object::object *>(test_eval(input)), "test_closure_captures - not a fn obj.");
+  std::string names;
+  for (const std::string &name : fn->proto().free_variables) {
+    names += name + ",";
+  }
+  assert_value(names, "b,a,len,", "test_closure_captures - free variables");
+  assert_value(fn->get_scope() == nullptr, true, "test_closure_captures - defining scope dropped");
+
+  using test_case = test_case_base<std::int64_t>;
+  std::vector<test_case> tc{
+      {"let f = fn(x) { let g = fn(y) { x + y }; g(1) + g(2) }; f(10);", 23},
+      {"let f = fn(n) { let fact = fn(k) { if (k < 2) { 1 } else { k * fact(k - 1) } }; fact(n) }; f(5);", 120},
+      {"let f = fn() { later(); }; let later = fn() { 42 }; f();", 42},
+      {"let x = 1; let f = fn() { x }; let x = 2; f();", 2},
+      {"let x = 1; let f = fn() { let x = x + 1; x }; f();", 2},
+      {"let x = 1; let f = fn() { if (true) { x }; let x = 5; x }; f();", 5},
+      {"let x = 1; let f = fn() { let y = x; let x = 7; y * 10 + x }; f();", 17},
+      {"let x = 1; let f = fn() { let g = fn() { x }; let x = 3; g() }; f();", 3},
+  };
+  for (int i = 0; i < tc.size(); i++) {
+    test_integer_object(test_eval(tc[i].input), tc[i].expected);
+  }
+  std::cout << "20 - ok: closures capture their free variables." << std::endl;
+}
+
+void test_shared_prototype() {
+  const char *input = R"(
+    let make = fn(k) { fn(x) { let y = x + k; y } };
+    [make(1), make(2), make(3)];
+  )";
+  object::array *closures = try_cast<object::array *>(
+      const_cast<object::object *>(test_eval(input)), "test_shared_prototype - not an array.");
+  std::vector<object::function *> fns;
+  for (object::object *o : closures->elements()) {
+    fns.push_back(try_cast<object::function *>(o, "test_shared_prototype - not a fn obj."));
+  }
+  const ast::prototype &proto = fns[0]->proto();
+  assert_value(&fns[1]->proto() == &proto && &fns[2]->proto() == &proto, true, "test_shared_prototype - shared");
+  assert_value(fns[2]->parameters().size(), 1, "test_shared_prototype - parameters kept");
+  assert_value(proto.arity, 1, "test_shared_prototype - arity");
+  assert_value(proto.slots, 2, "test_shared_prototype - slots");
+  assert_value((*fns[2]->captured().find("k"))->inspect(), "3", "test_shared_prototype - captured value");
+  // a closure with few captures is a single pool block
+  assert_value(sizeof(object::function) <= object::pool::max_block, true, "test_shared_prototype - closure size");
+  std::cout << "21 - ok: closures share the prototype of their literal." << std::endl;
+}
+
+void test_value_stack() {
+  value_stack &stack = value_stack::local();
+  test_integer_object(test_eval("let add = fn(a, b) { a + b }; add(add(1, 2), len(\"abc\"));"), 6);
+  assert_value(stack.size(), 0, "test_value_stack - balanced after calls");
+
+  const object::object *err = test_eval("let add = fn(a, b) { a + b }; add(1, add(2, x));");
+  assert_value(err->inspect(), "identifier not found: x", "test_value_stack - argument error");
+  assert_value(stack.size(), 0, "test_value_stack - balanced after error");
+
+  err = test_eval("let add = fn(a, b) { a + b }; add(1);");
+  assert_value(err->inspect(), "wrong number of arguments. got=1, want=2", "test_value_stack - arity");
+
+  object::builtin_fn_t len = object::as<object::builtin>(get_builtin("len"))->fn();
+  object::object *arg = new object::string("four");
+  test_integer_object(len(object::args_t(&arg, 1)), 4);
+  std::cout << "22 - ok: call arguments live on the value stack." << std::endl;
+}
+
+void test_inlined_program() {
+  std::vector<const char *> inputs{
+      "let sq = fn(x) { x * x }; let cube = fn(x) { x * sq(x) }; let a = 3; cube(a) + sq(4) + sq(a + 1);",
+      "let pick = fn(c, a, b) { if (c) { a } else { b } }; pick(true, 1, 2) + pick(false, 10, 20);",
+      "let limit = 10; let clamp = fn(x) { if (x > limit) { limit } else { x } }; [clamp(3), clamp(30)][1];",
+      "let first = fn(a) { a[0] }; let arr = [7, 8]; first(arr) + len(\"ab\");",
+  };
+  for (const char *input : inputs) {
+    lexer::lexer l(input);
+    parser::parser p(l);
+    std::shared_ptr<ast::program> program(p.parse_program());
+    std::string expected = test_eval(input)->inspect();
+    ast::inliner::report r = ast::inliner().run(*program);
+    if (r.inlined == 0) {
+      std::cout << "fail: test_inlined_program - nothing inlined in " << input << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    assert_value(evaluator::eval(program, new object::scope())->inspect(), expected,
+                 std::string("test_inlined_program - ") + input);
+  }
+
+  // calls whose meaning depends on the call site or on when arguments are
+  // evaluated are left alone
+  std::vector<const char *> unsafe{
+      "let f = fn(x) { x + y }; let g = fn(y) { let z = 0; f(1) }; g(5);",
+      "let a = 1; let g = fn() { a = 10; 0 }; let h = fn(x) { g() + x }; h(a);",
+      "let k = fn(x) { 1 }; k(nope);",
+      "let pick = fn(c, a, b) { if (c) { a } else { b } }; pick(true, 1, nope);",
+      "let k = fn(x) { 1 }; let a = k(a);",
+  };
+  for (const char *input : unsafe) {
+    lexer::lexer l(input);
+    parser::parser p(l);
+    std::shared_ptr<ast::program> program(p.parse_program());
+    std::string expected = test_eval(input)->inspect();
+    ast::inliner().run(*program);
+    assert_value(evaluator::eval(program, new object::scope())->inspect(), expected,
+                 std::string("test_inlined_program - ") + input);
+  }
+  std::cout << "23 - ok: evaluate inlined program." << std::endl;
+}
+
+void test_loops() {
+  using test_case = test_case_base<std::int64_t>;
+  std::vector<test_case> tc{
+      {"let i = 0; while (i < 10) { let i = i + 1; } i;", 10},
+      {"let sum = 0; for (x in [1, 2, 3, 4]) { let sum = sum + x; } sum;", 10},
+      {"let f = fn(a) { for (x in a) { if (x > 2) { return x; } } -1 }; f([1, 2, 5, 7]);", 5},
+      {"let f = fn(a) { for (x in a) { if (x > 9) { return x; } } -1 }; f([1, 2]);", -1},
+      {"let n = 0; for (x in []) { let n = 1; } n;", 0},
+      {"let i = 0; while (i < 200000) { let i = i + 1; } i;", 200000},
+  };
+  for (int i = 0; i < tc.size(); i++) {
+    test_integer_object(test_eval(tc[i].input), tc[i].expected);
+  }
+  test_null_object(test_eval("while (false) { }"));
+  assert_value(test_eval("for (x in 5) { x }")->inspect(), "for-in not supported: INTEGER", "test_loops - non-array");
+  assert_value(test_eval("while (1 + true) { }")->inspect(), "type mismatch: INTEGER + BOOLEAN", "test_loops - error");
+  assert_value(test_eval("") == nullptr, true, "test_loops - empty program");
+  assert_value(test_eval("while (false) { }")->inspect(), "null", "test_loops - loop that never runs");
+  std::cout << "24 - ok: while and for-in loops." << std::endl;
+}
+
+void test_assignment() {
+  using test_case = test_case_base<std::int64_t>;
+  std::vector<test_case> tc{
+      {"let i = 0; while (i < 10) { i = i + 1; } i;", 10},
+      {"let x = 1; let y = x = 5; x + y;", 10},
+      {"let x = 1; let f = fn() { x = x + 1; }; f(); f(); x;", 3},
+      {"let counter = fn() { let n = 0; fn() { n = n + 1 } }; let c = counter(); c(); c(); c();", 3},
+      {"let a = [1, 2, 3]; a[1] = 20; a[0] + a[1] + a[2];", 24},
+      {"let a = [1, 2, 3]; let b = a; b[0] = 7; a[0];", 7},
+      {"let a = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]; a[1] = 1; let i = 2; "
+       "while (i < 11) { a[i] = a[i - 1] + a[i - 2]; i = i + 1; } a[10];", 55},
+      {"let f = fn(x) { x = x * 2; x }; let x = 3; f(x) + x;", 9},
+  };
+  for (int i = 0; i < tc.size(); i++) {
+    test_integer_object(test_eval(tc[i].input), tc[i].expected);
+  }
+
+  // element stores run in place, a long loop of them stays linear
+  test_integer_object(test_eval("let counts = [0, 0, 0]; let i = 0; "
+      "while (i < 30000) { counts[i - (i / 3) * 3] = counts[i - (i / 3) * 3] + 1; i = i + 1; } counts[2];"), 10000);
+
+  assert_value(test_eval("y = 1;")->inspect(), "identifier not found: y", "test_assignment - unbound");
+  assert_value(test_eval("let a = [1]; a[1] = 2;")->inspect(), "index out of range: 1", "test_assignment - range");
+  assert_value(test_eval("let a = 1; a[0] = 2;")->inspect(), "index assignment not supported: INTEGER INTEGER",
+      "test_assignment - not an array");
+
+  // the parser only builds assignments to names and elements
+  auto bad = std::make_shared<ast::assign_expression>(token::span{}, new ast::int_literal(token::span{}, 1));
+  bad->set_value(new ast::int_literal(token::span{}, 2));
+  object::object *err = evaluator::eval(bad, new object::scope());
+  assert_value(err->inspect(), "cannot assign to 1", "test_assignment - target");
+  assert_value(object::as<object::error>(err)->code(), object::ASSIGN_TARGET_ERR, "test_assignment - target code");
+  std::cout << "25 - ok: assignment to bindings and array elements." << std::endl;
+}
+
+void test_lazy_errors() {
+  const object::object* first = test_eval("1 + true;");
+  const object::object* second = test_eval("let f = fn(x) { x + true }; f(2);");
+  auto* e = try_cast<const object::error*>(first, "test_lazy_errors - not an error");
+  assert_value(e->code(), object::TYPE_MISMATCH_ERR, "test_lazy_errors - code");
+  assert_value(e->left(), object::INTEGER_OBJ, "test_lazy_errors - left operand");
+  assert_value(e->op(), "+", "test_lazy_errors - operator");
+  assert_value(first == second, true, "test_lazy_errors - type errors are shared");
+  assert_value(first->abrupt(), true, "test_lazy_errors - errors end statement lists");
+  assert_value(test_eval("5;")->abrupt(), false, "test_lazy_errors - values do not");
+
+  assert_value(test_eval("true == 1")->inspect(), "type mismatch: BOOLEAN == INTEGER", "test_lazy_errors - two char operator");
+  assert_value(test_eval("-\"a\"")->inspect(), "unknown operator: -STRING", "test_lazy_errors - prefix");
+  assert_value(test_eval("len(1, 2)")->inspect(), "wrong number of arguments. got=2, want=1", "test_lazy_errors - counts");
+  assert_value(test_eval("5(1)")->inspect(), "not a function: INTEGER", "test_lazy_errors - not a function");
+
+  assert_value(test_eval("if (true + true) { 1 }") == test_eval("true + true;"), true,
+      "test_lazy_errors - repeated error allocates nothing");
+  std::cout << "26 - ok: lazily formatted, shared errors." << std::endl;
+}
+
+void test_string_constants() {
+  struct test_case {
+    const char* input;
+    bool expected;
+  };
+  std::vector<test_case> tc{
+      {R"("a" == "a")", true},
+      {R"("a" != "a")", false},
+      {R"("a" == "b")", false},
+      {R"("ab" == "a" + "b")", true},
+      {R"("a" + "b" != "a" + "c")", true},
+      {R"(let f = fn(s) { s + "!" }; f("x") == f("x"))", true},
+  };
+  for (int i = 0; i < tc.size(); i++) {
+    auto* res = try_cast<const object::boolean*>(test_eval(tc[i].input), std::string("test_string_constants - ") + tc[i].input);
+    assert_value(res->value(), tc[i].expected, std::string("test_string_constants - ") + tc[i].input);
+  }
+
+  // a literal in a recursive function is materialised once
+  const object::object* res = test_eval(R"(let f = fn(n) { if (n == 0) { [] } else { let r = f(n - 1); [r, "leaf"] } };
+      let t = f(3); [t[1], t[0][1], t[0][0][1]])");
+  const auto& leaves = try_cast<const object::array*>(res, "test_string_constants - not an array")->elements();
+  assert_value(leaves[0] == leaves[1] && leaves[1] == leaves[2], true, "test_string_constants - shared constant");
+  assert_value(object::as<object::string>(leaves[0])->interned(), true, "test_string_constants - interned");
+
+  assert_value(object::string::intern("leaf") == leaves[0], true, "test_string_constants - intern table");
+  assert_value(object::as<object::string>(test_eval(R"("le" + "af")"))->interned(), false, 
+      "test_string_constants - runtime strings are not interned");
+  std::cout << "27 - ok: string constants and equality." << std::endl;
+}
+
+void test_string_ropes() {
+  test_integer_object(test_eval(R"(let s = ""; let i = 0; 
+      while (i < 20000) { s = s + "fragment "; i = i + 1; } len(s);)"), 180000);
+
+  const object::object* res = test_eval(R"(let s = ""; for (w in ["a", "b", "c"]) { s = s + w; } 
+      let t = "0123456789012345678901234567890123456789"; let u = t + t; [s, u, u + u, u == t + t])");
+  const auto& elements = try_cast<const object::array*>(res, "test_string_ropes - not an array")->elements();
+  auto* abc = object::as<object::string>(elements[0]);
+  auto* u = object::as<object::string>(elements[1]);
+  auto* uu = object::as<object::string>(elements[2]);
+  assert_value(abc->is_rope(), false, "test_string_ropes - short results are flat");
+  assert_value(abc->value(), "abc", "test_string_ropes - short concatenation");
+  assert_value(u->is_rope(), false, "test_string_ropes - compared rope was flattened");
+  assert_value(uu->is_rope(), true, "test_string_ropes - long concatenation");
+  assert_value(uu->size(), 160, "test_string_ropes - rope size");
+  assert_value(elements[3], TRUE_O, "test_string_ropes - rope equality");
+  assert_value(uu->inspect(), std::string(u->value()) + std::string(u->value()), "test_string_ropes - printing flattens");
+  assert_value(uu->is_rope(), false, "test_string_ropes - flattened in place");
+
+  object::string* acc = new object::string("");
+  std::string expected;
+  for (int i = 0; i < 3000; i++) {
+    std::string piece = std::to_string(i) + ",";
+    acc = object::string::concat(acc, new object::string(piece));
+    expected += piece;
+    if (acc->depth() > object::string::max_depth) {
+      std::cout << "fail: test_string_ropes - depth " << acc->depth() << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  assert_value(acc->size(), expected.size(), "test_string_ropes - rebalanced size");
+  assert_value(acc->value(), expected, "test_string_ropes - rebalanced contents");
+  std::cout << "28 - ok: rope strings." << std::endl;
+}
+
+void test_utf8_strings() {
+  using test_case = test_case_base<std::int64_t>;
+  std::vector<test_case> tc{
+      {R"(len("héllo"))", 5},
+      {R"(len("日本語"))", 3},
+      {R"(len("ascii only, long enough for a full block"))", 40},
+      {R"(len("a block of ascii, then ünïcödé, then ascii again"))", 48},
+      {R"(let s = "ü"; let i = 0; while (i < 10) { s = s + s; i = i + 1; } len(s);)", 1024},
+      {"len(\"\xff\xfe\")", 2},
+  };
+  for (int i = 0; i < tc.size(); i++) {
+    test_integer_object(test_eval(tc[i].input), tc[i].expected);
+  }
+
+  assert_value(test_eval(R"("日本語"[1])")->inspect(), "本", "test_utf8_strings - index");
+  assert_value(test_eval(R"("héllo"[4])")->inspect(), "o", "test_utf8_strings - index after multibyte");
+  assert_value(test_eval(R"("abc"[1])") == test_eval(R"("b")"), true, "test_utf8_strings - ascii characters are interned");
+  test_null_object(test_eval(R"("abc"[3])"));
+  test_null_object(test_eval(R"("abc"[-1])"));
+
+  const object::object* res = test_eval(R"(let t = "ünïcödé ünïcödé ünïcödé ünïcödé ünïcödé"; let u = t + t; [u, len(u)])");
+  const auto& elements = try_cast<const object::array*>(res, "test_utf8_strings - not an array")->elements();
+  assert_value(object::as<object::string>(elements[0])->is_rope(), true, "test_utf8_strings - len does not flatten");
+  test_integer_object(elements[1], 78);
+
+  // both sides are known to be invalid, so the rope is too, without a scan
+  res = test_eval("let t = \"\xff 0123456789abcdef 0123456789abcdef 0123456789abcdef\"; let u = t + t; [u, len(u)]");
+  const auto& invalid = try_cast<const object::array*>(res, "test_utf8_strings - not an array")->elements();
+  assert_value(object::as<object::string>(invalid[0])->is_rope(), true, "test_utf8_strings - invalid rope is not scanned");
+  test_integer_object(invalid[1], 104);
+
+  // a sequence split between the sides of a rope is still found
+  object::string* split = object::string::concat(new object::string(std::string(40, 'a') + "\xc3"),
+                                                 new object::string("\xa9" + std::string(40, 'b')));
+  assert_value(split->is_utf8(), true, "test_utf8_strings - sequence split between rope sides");
+  assert_value(split->length(), std::size_t(81), "test_utf8_strings - length of split sequence rope");
+
+  struct scan_case {
+    const char* input;
+    bool valid;
+    std::size_t code_points;
+  };
+  std::vector<scan_case> sc{
+      {"", true, 0},
+      {"h\xc3\xa9", true, 2},
+      {"\xf0\x9f\x98\x80 0123456789abcdef", true, 18},
+      {"\xc0\xaf", false, 2},          // overlong
+      {"\xed\xa0\x80", false, 3},      // surrogate
+      {"0123456789abcd\xe6\x97", false, 16}, // truncated at the end of a block
+      {"0123456789abcde\xe6\x97\xa5xyz", true, 19}, // straddles two blocks
+  };
+  for (const scan_case& c : sc) {
+    utf8::info info = utf8::scan(c.input);
+    assert_value(info.valid, c.valid, std::string("test_utf8_strings - valid ") + c.input);
+    if (c.valid) {
+      assert_value(info.code_points, c.code_points, std::string("test_utf8_strings - count ") + c.input);
+    }
+  }
+  std::cout << "29 - ok: utf-8 strings." << std::endl;
+}
+
+void test_slices() {
+  using test_case = test_case_base<std::int64_t>;
+  std::vector<test_case> tc{
+      {"let a = [1, 2, 3, 4, 5]; let s = a[1:4]; len(s) * 10 + s[0];", 32},
+      {"let a = [1, 2, 3]; len(a[:]) + len(a[2:]) + len(a[:1]) + len(a[5:]) + len(a[2:1]);", 5},
+      {"let a = [1, 2, 3]; let s = a[0:2]; s[0] = 10; a[0];", 1},
+      {"let a = [1, 2, 3]; let s = a[0:2]; a[0] = 10; s[0];", 1},
+      {"let a = [1, 2, 3]; let s = a[:]; s[1] = 7; s[1] + a[1];", 9},
+      {"let sum = fn(a) { if (len(a) == 0) { 0 } else { a[0] + sum(rest(a)) } }; sum([1, 2, 3, 4, 5, 6]);", 21},
+      {"len(rest([])) + len(rest([1]));", 0},
+      {R"(len("héllo wörld"[2:7]))", 5},
+  };
+  for (int i = 0; i < tc.size(); i++) {
+    test_integer_object(test_eval(tc[i].input), tc[i].expected);
+  }
+
+  assert_value(test_eval(R"("héllo wörld"[1:5])")->inspect(), "éllo", "test_slices - string slice");
+  assert_value(test_eval(R"(substr("héllo wörld", 6))")->inspect(), "wörld", "test_slices - substr to the end");
+  assert_value(test_eval(R"(substr("héllo wörld", 1, 3))")->inspect(), "éll", "test_slices - substr count");
+
+  const object::object* res = test_eval(R"(let a = [1, 2, 3, true]; let t = "a long string, long enough to be viewed rather than copied by a slice"; 
+      [a, rest(a), t[2:], t[2:8]])");
+  const auto& elements = try_cast<const object::array*>(res, "test_slices - not an array")->elements();
+  auto* parent = object::as<object::array>(elements[0]);
+  auto* tail = object::as<object::array>(elements[1]);
+  assert_value(tail->elements().data(), parent->elements().data() + 1, "test_slices - rest shares storage");
+  assert_value(parent->shares_storage(), true, "test_slices - parent storage is shared");
+  assert_value(object::as<object::string>(elements[2])->is_view(), true, "test_slices - long string slices are views");
+  assert_value(object::as<object::string>(elements[2])->value(), "long string, long enough to be viewed rather than copied by a slice",
+      "test_slices - view contents");
+  assert_value(object::as<object::string>(elements[3])->is_view(), false, "test_slices - short string slices are copied");
+
+  assert_value(test_eval("5[1:2]")->inspect(), "slice operator not supported: INTEGER INTEGER", "test_slices - left type");
+  assert_value(test_eval("[1][true:]")->inspect(), "slice operator not supported: ARRAY BOOLEAN", "test_slices - bound type");
+  assert_value(test_eval("rest(1)")->inspect(), "argument to rest not supported, got INTEGER", "test_slices - rest type");
+  std::cout << "30 - ok: array and string slices." << std::endl;
+}
+
+void test_persistent_arrays() {
+  using test_case = test_case_base<std::int64_t>;
+  std::vector<test_case> tc{
+      {"let a = [1, 2, 3]; let b = push(a, 4); len(a) * 10 + len(b);", 34},
+      {"let a = [1, 2, 3]; let b = set(a, 1, 20); a[1] * 100 + b[1];", 220},
+      {"let a = push([1], 2); let b = push(a, 3); let c = push(a, 4); b[2] * 10 + c[2];", 34},
+      {"let a = concat([1, 2], [3, 4, 5]); len(a) * 10 + a[4];", 55},
+      {"let a = push([1, 2, 3, 4], 5); let s = a[1:3]; let t = push(s, 9); len(t) * 10 + t[2] + a[3];", 43},
+      {"let a = push([1, 2], 3); a[0] = 5; let sum = 0; for (x in a) { sum = sum + x; } sum;", 10},
+      // a push loop shares every node but the last path, it stays linear
+      {"let a = []; let i = 0; while (i < 20000) { a = push(a, i); i = i + 1; } len(a) + a[19999] + a[1056];", 41055},
+      {"let a = [0, 0, 0]; let b = a; let i = 0; while (i < 300) { b = set(b, i - (i / 3) * 3, i); i = i + 1; } "
+       "a[2] + b[0] + b[1] + b[2];", 894},
+  };
+  for (int i = 0; i < tc.size(); i++) {
+    test_integer_object(test_eval(tc[i].input), tc[i].expected);
+  }
+
+  // a trie three levels deep, every version keeps its own elements
+  object::array* empty = new object::array({});
+  std::vector<object::array*> versions{empty};
+  for (std::int64_t i = 0; i < 40000; i++) {
+    versions.push_back(versions.back()->push(new object::integer(i)));
+  }
+  for (std::size_t n : {1, 32, 33, 1056, 1057, 40000}) {
+    auto* v = versions[n];
+    assert_value(v->size(), n, "test_persistent_arrays - size");
+    assert_value(object::as<object::integer>(v->at(n - 1))->value(), std::int64_t(n - 1), "test_persistent_arrays - last element");
+  }
+  object::array* big = versions.back();
+  object::array* changed = big->updated(1056, new object::integer(-1));
+  assert_value(object::as<object::integer>(big->at(1056))->value(), 1056, "test_persistent_arrays - set keeps the original");
+  assert_value(object::as<object::integer>(changed->at(1056))->value(), -1, "test_persistent_arrays - set");
+  assert_value(big->is_persistent(), true, "test_persistent_arrays - persistent form");
+  assert_value(object::as<object::integer>(big->elements()[35000])->value(), 35000, "test_persistent_arrays - elements");
+  assert_value(big->is_persistent(), false, "test_persistent_arrays - contiguous after elements()");
+
+  const object::object* res = test_eval("let a = [1, 2, 3]; [a, push(a, 4), concat(a, a), set(a, 0, 5)]");
+  auto outer = try_cast<const object::array*>(res, "test_persistent_arrays - not an array");
+  assert_value(object::as<object::array>(outer->at(0))->is_int64(), true, "test_persistent_arrays - updates leave the source unboxed");
+  assert_value(res->inspect(), "[[1, 2, 3], [1, 2, 3, 4], [1, 2, 3, 1, 2, 3], [5, 2, 3]]", "test_persistent_arrays - updates of integers");
+
+  assert_value(test_eval("push(1, 2)")->inspect(), "argument to push not supported, got INTEGER", "test_persistent_arrays - push type");
+  assert_value(test_eval("set([1], 1, 2)")->inspect(), "index out of range: 1", "test_persistent_arrays - set range");
+  assert_value(test_eval("concat([1], 2)")->inspect(), "argument to concat not supported, got INTEGER", "test_persistent_arrays - concat type");
+  assert_value(test_eval("push([1])")->inspect(), "wrong number of arguments. got=1, want=2", "test_persistent_arrays - arguments");
+  std::cout << "31 - ok: persistent arrays with structural sharing." << std::endl;
+}
+
+void test_hash_maps() {
+  using test_case = test_case_base<std::int64_t>;
+  std::vector<test_case> tc{
+      {R"(let h = {"one": 1, "two": 2, 3: 3, true: 4}; h["one"] + h["t" + "wo"] + h[3] + h[true];)", 10},
+      {R"(let h = {"a": 1}; h["a"] = 5; h["b"] = 6; len(h) * 100 + h["a"] * 10 + h["b"];)", 256},
+      {R"(let h = {}; insert(insert(h, 1, 10), 2, 20); h[1] + h[2];)", 30},
+      {R"(let h = {"x": 1, "x": 2}; len(h) * 10 + h["x"];)", 12},
+      {R"(let k = "k"; let h = {k: 1}; h[substr("kk", 1)];)", 1},
+      {R"(let sum = 0; for (v in values({"a": 1, "b": 2, "c": 3})) { sum = sum + v; } sum;)", 6},
+      // entries grow the table past many rehashes, every key stays reachable
+      {"let h = {}; let i = 0; while (i < 5000) { h[i * 7] = i; i = i + 1; } "
+       "let hits = 0; i = 0; while (i < 5000) { if (h[i * 7] == i) { hits = hits + 1; } i = i + 1; } hits;", 5000},
+  };
+  for (int i = 0; i < tc.size(); i++) {
+    test_integer_object(test_eval(tc[i].input), tc[i].expected);
+  }
+  test_null_object(test_eval(R"({"a": 1}["b"])"));
+  test_null_object(test_eval(R"({}[false])"));
+  assert_value(test_eval(R"(keys({"b": 1, "a": 2, 3: 3}))")->inspect(), "[b, a, 3]", "test_hash_maps - keys in insertion order");
+  assert_value(test_eval(R"({"b": 1, "a": [2]})")->inspect(), "{b: 1, a: [2]}", "test_hash_maps - inspect");
+
+  object::hash_map* h = new object::hash_map();
+  for (std::int64_t i = 0; i < 1000; i++) {
+    h->set(new object::integer(i), new object::integer(i * i));
+  }
+  assert_value(h->size(), 1000, "test_hash_maps - size");
+  assert_value(h->capacity() * 7 >= h->size() * 8, true, "test_hash_maps - load factor");
+  object::integer key(999);
+  assert_value(object::as<object::integer>(h->get(&key))->value(), 998001, "test_hash_maps - lookup by value");
+  object::integer missing(1000);
+  assert_value(h->get(&missing) == nullptr, true, "test_hash_maps - missing key");
+
+  assert_value(test_eval("{fn(x) { x }: 1}")->inspect(), "unusable as hash key: FUNCTION", "test_hash_maps - literal key");
+  assert_value(test_eval(R"({"a": 1}[[1]])")->inspect(), "unusable as hash key: ARRAY", "test_hash_maps - index key");
+  assert_value(test_eval("let h = {}; h[{}] = 1;")->inspect(), "unusable as hash key: HASH", "test_hash_maps - assignment key");
+  assert_value(test_eval("keys([1])")->inspect(), "argument to keys not supported, got ARRAY", "test_hash_maps - keys type");
+  std::cout << "32 - ok: hash maps." << std::endl;
+}
+
+void test_int64_arrays() {
+  using test_case = test_case_base<std::int64_t>;
+  std::vector<test_case> tc{
+      {"sum([1, 2, 3, 4, 5, 6, 7]);", 28},
+      {"min([5, -3, 9, 2, 8, -1, 7]) * 10 + max([5, -3, 9, 2, 8, -1, 7]);", -21},
+      {"dot([1, 2, 3, 4, 5], [6, 7, 8, 9, 10]);", 130},
+      {"count([1, 2, 1, 3, 1, 4, 1, 5, 1], 1);", 5},
+      {"sum([1, 2, 3, 4, 5][1:4]);", 9},
+      {"let a = [1, 2, 3]; a[0] = 10; sum(a);", 15},
+      {"let a = [1, 2, 3]; let b = a[:]; b[0] = 10; sum(a) * 100 + sum(b);", 615},
+      {"sum(push([1, 2], 3)) + sum([]);", 6},
+      {R"(count(["a", "b", "a"], "a") + count([1, 2], "a") + count([true, 1], true);)", 3},
+      {"let a = [1, 2, 3]; let n = 0; for (x in a) { n = n + x; } n + a[2];", 9},
+  };
+  for (int i = 0; i < tc.size(); i++) {
+    test_integer_object(test_eval(tc[i].input), tc[i].expected);
+  }
+  test_null_object(test_eval("min([])"));
+  assert_value(test_eval(R"(let a = [1, 2, 3]; a[1] = "x"; a)")->inspect(), "[1, x, 3]", "test_int64_arrays - boxed on store");
+
+  const object::object* res = test_eval("let a = [1, 2, 3, 4]; a[1] = true; [[1, 2, 3, 4], a, [1, true], []]");
+  auto outer = try_cast<const object::array*>(res, "test_int64_arrays - not an array");
+  auto ints = object::as<object::array>(outer->at(0));
+  assert_value(outer->is_int64(), false, "test_int64_arrays - nested arrays are boxed");
+  assert_value(ints->is_int64(), true, "test_int64_arrays - integer literal");
+  assert_value(object::as<object::array>(outer->at(1))->is_int64(), false, "test_int64_arrays - non-integer store");
+  assert_value(object::as<object::array>(outer->at(2))->is_int64(), false, "test_int64_arrays - mixed literal");
+  assert_value(object::as<object::array>(outer->at(3))->is_int64(), false, "test_int64_arrays - empty literal");
+  assert_value(ints->slice(1, 3)->int64().data(), ints->int64().data() + 1, "test_int64_arrays - slices share values");
+
+  // the dispatched kernels agree with the scalar ones, on every tail length and on overflow
+  std::vector<std::int64_t> a, b;
+  std::uint64_t x = 12345;
+  for (int i = 0; i < 1003; i++) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    a.push_back(static_cast<std::int64_t>(x));
+    b.push_back(static_cast<std::int64_t>(x >> 40) - (1 << 23));
+  }
+  for (std::size_t n : {1, 2, 3, 4, 5, 7, 8, 9, 1003}) {
+    std::span<const std::int64_t> va(a.data(), n), vb(b.data(), n);
+    assert_value(kernels::sum(va), kernels::scalar::sum(va), "test_int64_arrays - sum kernel");
+    assert_value(kernels::min(vb), kernels::scalar::min(vb), "test_int64_arrays - min kernel");
+    assert_value(kernels::max(va), kernels::scalar::max(va), "test_int64_arrays - max kernel");
+    assert_value(kernels::dot(va, vb), kernels::scalar::dot(va, vb), "test_int64_arrays - dot kernel");
+    assert_value(kernels::count(vb, b[0]), kernels::scalar::count(vb, b[0]), "test_int64_arrays - count kernel");
+  }
+
+  assert_value(test_eval(R"(sum([1, "a"]))")->inspect(), "argument to sum not supported, got STRING", "test_int64_arrays - element type");
+  assert_value(test_eval("max(1)")->inspect(), "argument to max not supported, got INTEGER", "test_int64_arrays - argument type");
+  assert_value(test_eval("dot([1], [1, 2])")->inspect(), "length mismatch: 1 and 2", "test_int64_arrays - lengths");
+  std::cout << "33 - ok: unboxed integer arrays." << std::endl;
+}
+
+void test_array_operators() {
+  std::vector<std::pair<const char*, const char*>> tc{
+      {"[1, 2, 3] + [10, 20, 30]", "[11, 22, 33]"},
+      {"[1, 2, 3, 4, 5] * 2", "[2, 4, 6, 8, 10]"},
+      {"10 - [1, 2, 3]", "[9, 8, 7]"},
+      {"[10, 20, 30, 40, 50] / [1, 2, 3, 4, 5]", "[10, 10, 10, 10, 10]"},
+      {"[1, 5, 3, 7, 2] > 2", "[false, true, true, true, false]"},
+      {"[1, 2, 3] == [1, 0, 3]", "[true, false, true]"},
+      {"[1, 2, 3] != 2", "[true, false, true]"},
+      {"2 < [1, 2, 3]", "[false, false, true]"},
+      {"let a = [4, 1, 7, 3, 9, 2]; a[a > 3]", "[4, 7, 9]"},
+      {R"(["a", "b"] + "!")", "[a!, b!]"},
+      {"[[1, 2], [3, 4]] * 10", "[[10, 20], [30, 40]]"},
+      {"[[1, 2], [3, 4]] + [1, 2]", "[[2, 3], [5, 6]]"},
+      {"[true, false] == true", "[true, false]"},
+      {"[] + 1", "[]"},
+      {"push([1, 2], 3) * 2", "[2, 4, 6]"},
+  };
+  for (const auto& [input, expected] : tc) {
+    assert_value(test_eval(input)->inspect(), expected, std::string("test_array_operators - ") + input);
+  }
+  test_integer_object(test_eval("let a = [1, 2, 3, 4, 5, 6, 7, 8, 9]; sum(a * a) - dot(a, a);"), 0);
+  test_integer_object(test_eval("let a = [3, 1, 4, 1, 5, 9, 2, 6]; len(a[a > 2]) * 100 + sum(a[a < 3]);"), 504);
+
+  const object::object* res = test_eval("[[1, 2, 3] * 2, push([1], 2) + 1, [1, 2] > 1]");
+  auto outer = try_cast<const object::array*>(res, "test_array_operators - not an array");
+  assert_value(object::as<object::array>(outer->at(0))->is_int64(), true, "test_array_operators - kernel result is unboxed");
+  assert_value(object::as<object::array>(outer->at(1))->is_int64(), true, "test_array_operators - boxed integers give unboxed result");
+  assert_value(object::as<object::array>(outer->at(2))->is_int64(), false, "test_array_operators - masks are boxed");
+
+  // the dispatched kernel agrees with the scalar one, with and without broadcasting
+  std::vector<std::int64_t> a, b, out(11), expected(11);
+  std::uint64_t x = 777;
+  for (int i = 0; i < 11; i++) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    a.push_back(static_cast<std::int64_t>(x));
+    b.push_back(i % 3 == 0 ? a.back() : static_cast<std::int64_t>(x >> 33) - (1LL << 30));
+  }
+  for (kernels::op o : {kernels::op::add, kernels::op::sub, kernels::op::mul, kernels::op::lt, kernels::op::gt, kernels::op::eq, kernels::op::ne}) {
+    for (std::span<const std::int64_t> rhs : {std::span<const std::int64_t>(b), std::span<const std::int64_t>(b.data() + 3, 1)}) {
+      kernels::elementwise(o, a, rhs, out);
+      kernels::scalar::elementwise(o, a, rhs, expected);
+      assert_value(out == expected, true, "test_array_operators - kernel");
+    }
+  }
+
+  std::vector<std::pair<const char*, const char*>> errors{
+      {"[1, 2, 3] + [1, 2]", "length mismatch: 3 and 2"},
+      {"[1, 2] / [1, 0]", "division by zero"},
+      {"1 / 0", "division by zero"},
+      {"[1] / 0", "division by zero"},
+      {"[1, 2] + true", "type mismatch: INTEGER + BOOLEAN"},
+      {"[1, 2][[true]]", "length mismatch: 2 and 1"},
+      {"[1, 2][[1, 2]]", "index operator not supported: ARRAY INTEGER"},
+  };
+  for (const auto& [input, expected] : errors) {
+    assert_value(test_eval(input)->inspect(), expected, std::string("test_array_operators - ") + input);
+  }
+  assert_value(test_eval("1 / 0") == test_eval("[1] / 0"), true, "test_array_operators - division errors are shared");
+  // INT64_MIN / -1 wraps around like the other operators
+  test_integer_object(test_eval("(-9223372036854775807 - 1) / -1"), INT64_MIN);
+  assert_value(test_eval("[-9223372036854775807 - 1, 6] / -1")->inspect(), "[-9223372036854775808, -6]", "test_array_operators - INT64_MIN / -1");
+  std::cout << "34 - ok: element-wise array operators." << std::endl;
+}
+
+void test_higher_order_builtins() {
+  std::vector<std::pair<const char*, const char*>> tc{
+      {"map([1, 2, 3], fn(x) { x * 2 })", "[2, 4, 6]"},
+      {"filter([1, 2, 3, 4, 5, 6], fn(x) { x > 3 })", "[4, 5, 6]"},
+      {"reduce([1, 2, 3, 4], fn(acc, x) { acc + x }, 10)", "20"},
+      {"reduce([1, 2, 3, 4], fn(acc, x) { acc * x })", "24"},
+      {"reduce([], fn(acc, x) { acc + x })", "null"},
+      {"let n = 0; each([1, 2, 3], fn(x) { n = n + x; }); n", "6"},
+      {"find([1, 2, 3, 4], fn(x) { x > 2 })", "3"},
+      {"find([1, 2], fn(x) { x > 2 })", "null"},
+      {"map([[1], [1, 2], []], len)", "[1, 2, 0]"},
+      {"let k = 3; map([1, 2], fn(x) { x * k })", "[3, 6]"},
+      {"map([1, 2], fn(x) { let y = x + 1; y * y })", "[4, 9]"},
+      {"map([1, -2, 3], fn(x) { if (x < 0) { return 0; } x })", "[1, 0, 3]"},
+      {"map(map([1, 2], fn(x) { fn(y) { x + y } }), fn(f) { f(10) })", "[11, 12]"},
+      {"let fact = fn(n) { if (n < 2) { 1 } else { n * fact(n - 1) } }; map([3, 4, 5], fact)", "[6, 24, 120]"},
+      {"map([1, 2], fn(x) { map([10, 20], fn(y) { x * y }) })", "[[10, 20], [20, 40]]"},
+  };
+  for (const auto& [input, expected] : tc) {
+    assert_value(test_eval(input)->inspect(), expected, std::string("test_higher_order_builtins - ") + input);
+  }
+  test_integer_object(test_eval("let a = []; let i = 0; while (i < 3000) { a = push(a, i); i = i + 1; } "
+      "sum(map(filter(a, fn(x) { x - (x / 2) * 2 == 0 }), fn(x) { x * 2 }));"), 4497000);
+
+  // the fast path is only taken for functions that bind nothing but their parameters
+  auto* simple = const_cast<object::object*>(test_eval("fn(x) { x * 2 }"));
+  auto* with_let = const_cast<object::object*>(test_eval("fn(x) { let y = x; y }"));
+  auto* escaping = const_cast<object::object*>(test_eval("fn(x) { fn() { x } }"));
+  assert_value(callback(simple).fast(), true, "test_higher_order_builtins - simple callback");
+  assert_value(callback(with_let).fast(), false, "test_higher_order_builtins - callback with let");
+  assert_value(callback(escaping).fast(), false, "test_higher_order_builtins - escaping callback");
+  callback twice(simple);
+  object::integer one(1), two(2);
+  object::object* first[] = {&one};
+  object::object* second[] = {&two};
+  assert_value(object::as<object::integer>(twice(first))->value() * 10 + object::as<object::integer>(twice(second))->value(), 24,
+      "test_higher_order_builtins - frame reused across calls");
+
+  std::vector<std::pair<const char*, const char*>> errors{
+      {"map(1, fn(x) { x })", "argument to map not supported, got INTEGER"},
+      {"filter([1], 1)", "argument to filter not supported, got INTEGER"},
+      {"map([1], fn(a, b) { a })", "wrong number of arguments. got=1, want=2"},
+      {R"(map([1, "a"], fn(x) { x + 1 }))", "type mismatch: STRING + INTEGER"},
+      {"reduce([1])", "wrong number of arguments. got=1, want=3"},
+  };
+  for (const auto& [input, expected] : errors) {
+    assert_value(test_eval(input)->inspect(), expected, std::string("test_higher_order_builtins - ") + input);
+  }
+  std::cout << "35 - ok: higher-order builtins." << std::endl;
+}
+
+void test_lazy_sequences() {
+  std::vector<std::pair<const char*, const char*>> tc{
+      {"range(5)", "range(0, 5)"},
+      {"range(10, 0, -3)", "range(10, 0, -3)"},
+      {"collect(range(10, 0, -3))", "[10, 7, 4, 1]"},
+      {"len(range(0, 10, 3))", "4"},
+      {"len(range(5, 0))", "0"},
+      {"range(2, 8)[3]", "5"},
+      {"range(2, 8)[6]", "null"},
+      {"map(range(4), fn(x) { x * x })", "lazy sequence"},
+      {"collect(map(range(4), fn(x) { x * x }))", "[0, 1, 4, 9]"},
+      {"collect(take(filter(range(100), fn(x) { x - (x / 7) * 7 == 0 }), 3))", "[0, 7, 14]"},
+      {"collect(take(range(3), 10))", "[0, 1, 2]"},
+      {"collect(take(range(3), 0))", "[]"},
+      {"collect(map(iter([1, 2, 3]), fn(x) { x + 1 }))", "[2, 3, 4]"},
+      {"let n = 0; for (x in range(1, 5)) { n = n + x; } n", "10"},
+      {"let n = 0; for (x in map(range(3), fn(x) { x * 10 })) { n = n + x; } n", "30"},
+      {"let f = fn() { for (x in range(10)) { if (x == 4) { return x; } } }; f()", "4"},
+      {"reduce(range(1, 6), fn(acc, x) { acc * x })", "120"},
+      {"find(map(range(100), fn(x) { x * x }), fn(x) { x > 50 })", "64"},
+      {"max(map(range(10), fn(x) { 5 - x }))", "5"},
+  };
+  for (const auto& [input, expected] : tc) {
+    assert_value(test_eval(input)->inspect(), expected, std::string("test_lazy_sequences - ") + input);
+  }
+  test_integer_object(test_eval("sum(map(range(0, 20000), fn(x) { x * x }))"), 2666466670000);
+
+  // take stops pulling from its source once it has enough elements
+  test_integer_object(test_eval("let calls = 0; let s = take(map(range(1000), fn(x) { calls = calls + 1; x }), 5); "
+      "collect(s); calls"), 5);
+
+  // pipelines of simple integer callbacks run unboxed, their size does not matter
+  std::size_t small = object::pool::local().totals().live;
+  test_eval("sum(map(range(0, 100), fn(x) { x * 2 }))");
+  std::size_t grown = object::pool::local().totals().live;
+  test_eval("sum(map(range(0, 100000), fn(x) { x * 2 }))");
+  assert_value(object::pool::local().totals().live - grown, grown - small, "test_lazy_sequences - constant space");
+  std::vector<std::pair<const char*, const char*>> unboxed{
+      {"let k = 3; sum(map(filter(range(10), fn(x) { x - (x / 2) * 2 == 0 }), fn(x) { -x * k }))", "-60"},
+      {"collect(take(map(range(10, 0, -1), fn(x) { return x * x; }), 3))", "[100, 81, 64]"},
+      {"max(filter(iter([3, 9, 4]), fn(x) { x != 9 }))", "4"},
+      {"map([1, 2, 3], fn(x) { x > 1 })", "[false, true, true]"},
+      {"filter([1, 2, 3], fn(x) { x })", "[1, 2, 3]"},
+      {"sum(map(range(10), fn(x) { 10 / (x - 5) }))", "division by zero"},
+      {"sum(map(range(3), fn(x) { x + k }))", "identifier not found: k"},
+  };
+  for (const auto& [input, expected] : unboxed) {
+    assert_value(test_eval(input)->inspect(), expected, std::string("test_lazy_sequences - ") + input);
+  }
+  assert_value(object::as<object::array>(test_eval("collect(map(range(3), fn(x) { x + 1 }))"))->is_int64(), true,
+      "test_lazy_sequences - collect unboxed");
+
+  // stages are fused into one sequence, the original is left alone
+  auto* base = object::as<object::sequence>(test_eval("map(range(3), fn(x) { x })"));
+  assert_value(base != nullptr, true, "test_lazy_sequences - map gives a sequence");
+  auto* piped = object::as<object::sequence>(test_eval("take(filter(map(range(3), fn(x) { x }), fn(x) { true }), 2)"));
+  assert_value(piped->stages().size(), std::size_t(3), "test_lazy_sequences - stages are fused");
+
+  std::vector<std::pair<const char*, const char*>> errors{
+      {"range(1, 2, 0)", "range step cannot be zero"},
+      {"range(true)", "argument to range not supported, got BOOLEAN"},
+      {"take(1, 2)", "argument to take not supported, got INTEGER"},
+      {"iter(1)", "argument to iter not supported, got INTEGER"},
+      {R"(collect(map(range(2), fn(x) { x + "a" })))", "type mismatch: INTEGER + STRING"},
+      {"for (x in 1) { x }", "for-in not supported: INTEGER"},
+  };
+  for (const auto& [input, expected] : errors) {
+    assert_value(test_eval(input)->inspect(), expected, std::string("test_lazy_sequences - ") + input);
+  }
+  assert_value(test_eval("range(1, 2, 0)") == test_eval("range(5, 0, 0)"), true, "test_lazy_sequences - step errors are shared");
+  std::cout << "36 - ok: lazy ranges and sequences." << std::endl;
+}
+
 } // namespace evaluator
 
 size_t parser::trace::_indent_level = 0;
@@ -380,6 +1133,26 @@ int main() {
   evaluator::test_builtin_function_errors();
   evaluator::test_array_literal();
   evaluator::test_array_index_expression();
+  evaluator::test_hash_consed_program();
+  evaluator::test_object_header();
+  evaluator::test_frame_escape();
+  evaluator::test_closure_captures();
+  evaluator::test_shared_prototype();
+  evaluator::test_value_stack();
+  evaluator::test_inlined_program();
+  evaluator::test_loops();
+  evaluator::test_assignment();
+  evaluator::test_lazy_errors();
+  evaluator::test_string_constants();
+  evaluator::test_string_ropes();
+  evaluator::test_utf8_strings();
+  evaluator::test_slices();
+  evaluator::test_persistent_arrays();
+  evaluator::test_hash_maps();
+  evaluator::test_int64_arrays();
+  evaluator::test_array_operators();
+  evaluator::test_higher_order_builtins();
+  evaluator::test_lazy_sequences();
 
   exit(EXIT_SUCCESS);
 }
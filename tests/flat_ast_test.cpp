@@ -0,0 +1,123 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/flat_ast.hpp"
+#include "../src/parser.hpp"
+
+namespace flat {
+
+template <typename T, typename V>
+void assert_value(const T& actual, const V& expected, std::string err_msg){
+    if(actual != expected) {
+        std::cout<<"fail: "<<err_msg<<" does not match. expected "<<expected<<" , got "<<actual<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+std::shared_ptr<ast::program> parse(const char* input) {
+    lexer::lexer l(input);
+    parser::parser p(l);
+    std::shared_ptr<ast::program> program(p.parse_program());
+    if(p.errors().size() != 0) {
+        std::cout<<"fail: parser errors for input "<<input<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return program;
+}
+
+void test_flatten_to_string() {
+    std::vector<const char*> inputs {
+        "let x = 5 * (2 + -a); return x;",
+        "if (a < b) { a } else { b }",
+        "let add = fn(x, y) { x + y; }; add(1, 2 * 3);",
+        R"(let s = "hello"; [1, s, true][1 + 0];)",
+        "while (i < 3) { let i = i + 1; } for (x in [1, 2]) { x; }",
+        "x = 1; a[0] = x + 1;",
+        "a[1:2]; a[:n]; a[n:]; a[:];",
+        R"({"a": 1, true: x + 1}; {};)",
+    };
+    for(const char* input : inputs) {
+        std::shared_ptr<ast::program> tree = parse(input);
+        program flat = flatten(*tree);
+        assert_value(flat.to_string(), tree->to_string(), "test_flatten_to_string - to_string");
+    }
+    std::cout<<"1 - ok: flattened program to_string."<<std::endl;
+}
+
+void test_flat_eval() {
+    std::vector<const char*> inputs {
+        "5 + 5 * 2 - -1",
+        "let a = 5; let b = a * 2; b == 10",
+        "if (1 > 2) { 10 } else { 20 }",
+        "let add = fn(x, y) { return x + y; }; add(add(1, 2), 3);",
+        "let counter = fn(x) { if (x > 100) { return x; } else { counter(x + 1); } }; counter(0);",
+        R"("Hello" + " " + "World!")",
+        R"(len("four"))",
+        R"(let s = fn() { "a" }; [s() == s(), "a" + "b" == "ab", "a" != "b"])",
+        "let a = [1, 2, 3]; a[0] + a[1] + a[2];",
+        "sum([1, 2, 3] * 2)",
+        "let i = 0; while (i < 10) { let i = i + 1; } i;",
+        "let n = 0; for (x in [1, 2, 3]) { let n = n + x; } n;",
+        "let f = fn(a) { for (x in a) { if (x > 2) { return x; } } -1 }; f([1, 2, 5, 7]);",
+        "let n = 0; for (x in range(4)) { let n = n + x * x; } n;",
+        "for (x in 5) { x }",
+        "let i = 0; while (i < 10) { i = i + 1; } i;",
+        "let a = [1, 2, 3]; a[1] = 5; let b = a; b[2] = 7; [a, b];",
+        "let f = fn() { n = n + 1 }; let n = 0; f(); f(); n;",
+        "let a = [1]; a[3] = 1;",
+        "y = 1;",
+        "let a = [1, 2, 3, 4]; [a[1:3], a[:2], a[2:], a[:]];",
+        R"("hello"[1:3] + "hello"[3:])",
+        "[1, 2][true:]",
+        "5[1:2]",
+        R"(let h = {"a": 1, 2: "b", true: [3]}; [h["a"], h[2], h[true], h["c"], len(h)];)",
+        R"(let h = {}; h["k"] = 5; h["k"] = h["k"] + 1; [h["k"], keys(h)];)",
+        "{[1]: 2}",
+        "5 + true;",
+        "foobar",
+    };
+    for(const char* input : inputs) {
+        std::shared_ptr<ast::program> tree = parse(input);
+        program flat = flatten(*tree);
+        object::object* expected = evaluator::eval(tree, new object::scope());
+        object::object* actual = eval(flat, new object::scope());
+        assert_value(actual->inspect(), expected->inspect(), std::string("test_flat_eval - ") + input);
+    }
+    // integer arrays are unboxed like in the tree evaluator
+    std::shared_ptr<ast::program> tree = parse("[1, 2, 3 * 4]");
+    auto* arr = object::as<object::array>(eval(flatten(*tree), new object::scope()));
+    assert_value(arr != nullptr && arr->is_int64(), true, "test_flat_eval - unboxed integer array");
+    std::cout<<"2 - ok: evaluate flattened program."<<std::endl;
+}
+
+void test_flat_footprint() {
+    std::string input;
+    for(int i = 0; i < 1000; i++) {
+        input += "let f = fn(x, y) { if (x < y) { x * 2 } else { y + 1 } };\n";
+    }
+    std::shared_ptr<ast::program> tree = parse(input.c_str());
+    program flat = flatten(*tree);
+    if(flat.bytes() / flat.size() > 24) {
+        std::cout<<"fail: test_flat_footprint - "<<flat.bytes() / flat.size()<<" bytes per node"<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout<<"3 - ok: flattened program footprint."<<std::endl;
+}
+
+} // namespace flat
+
+size_t parser::trace::_indent_level = 0;
+bool parser::trace::_enable_trace = 0;
+
+int main() {
+    std::cout<<"Running flat_ast_test.cpp..."<<std::endl;
+
+    flat::test_flatten_to_string();
+    flat::test_flat_eval();
+    flat::test_flat_footprint();
+
+    std::cout<<"flat_ast_test.cpp: ok"<<std::endl;
+
+    exit(EXIT_SUCCESS);
+}
@@ -192,6 +192,8 @@ void test_next_token_4() {
     10 != 9;
     5 == 5;
     [1, 2];
+    while for in
+    a[1:]
     )";
     std::vector<expected> test_case = {
         {token::IF, "if"},
@@ -229,6 +231,16 @@ void test_next_token_4() {
         {token::RBRACKET, "]"},
         {token::SEMICOLON, ";"},
 
+        {token::WHILE, "while"},
+        {token::FOR, "for"},
+        {token::IN, "in"},
+
+        {token::IDENT, "a"},
+        {token::LBRACKET, "["},
+        {token::INT, "1"},
+        {token::COLON, ":"},
+        {token::RBRACKET, "]"},
+
         {token::EOFT, ""}
     };
 
@@ -256,6 +268,65 @@ void test_next_token_4() {
     std::cout<<"ok - test_next_token_4()"<<std::endl;
 }
 
+void test_tokenize() {
+    const char* input = R"(
+    let add = fn(x, y) { x + y; };
+    if (add(1, 2) != 3) { return "three"; }
+    [1, 2][0] == 1;
+    )";
+
+    lexer streaming(input);
+    token_buffer buf = lexer(input).tokenize();
+    for(int i = 0; i < buf.size(); i++) {
+        token::token expected = streaming.next_token();
+        if(expected.get_type() != buf.type(i) || expected.token_literal() != buf.literal(i)){
+            std::cout << "test_tokenize - token " << i << " expected literal: "
+                << expected.token_literal()
+                << ", got: "
+                << buf.literal(i)
+                << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    if(buf.type(buf.size() - 1) != token::EOFT){
+        std::cout << "test_tokenize - buffer not terminated by EOFT" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if(buf.literal(5) != "x" || buf.offset(5) != std::string_view(input).find("x")){
+        std::cout << "test_tokenize - wrong offset for token 5, got: " << buf.offset(5) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout<<"ok - test_tokenize()"<<std::endl;
+}
+
+void test_line_table() {
+    const char* input = "let a = 1;\nlet bc = a;\n\n  bc";
+    lexer l(input);
+    line_table lines(input);
+
+    struct expected_position {
+        std::uint32_t line;
+        std::uint32_t column;
+    };
+    std::vector<expected_position> test_case = {
+        {1, 1}, {1, 5}, {1, 7}, {1, 9}, {1, 10},
+        {2, 1}, {2, 5}, {2, 8}, {2, 10}, {2, 11},
+        {4, 3},
+    };
+    for(int i = 0; i < test_case.size(); i++) {
+        token::token cur_token = l.next_token();
+        line_table::position pos = lines.locate(cur_token.span());
+        if(pos.line != test_case[i].line || pos.column != test_case[i].column){
+            std::cout << "test_line_table - token " << cur_token.token_literal() 
+                << " expected " << test_case[i].line << ":" << test_case[i].column
+                << ", got: " << pos.line << ":" << pos.column
+                << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    std::cout<<"ok - test_line_table()"<<std::endl;
+}
+
 } // namespace lexer
 
 
@@ -266,6 +337,8 @@ int main(int argc, char* argv[]) {
     lexer::test_next_token_2();
     lexer::test_next_token_3();
     lexer::test_next_token_4();
+    lexer::test_tokenize();
+    lexer::test_line_table();
 
     std::cout<<"lexer_test.cpp: ok"<<std::endl;
 
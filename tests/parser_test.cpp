@@ -573,6 +573,166 @@ void test_parse_index_expression() {
     std::cout<<"15 - ok: parse index expression."<<std::endl;
 }
 
+void test_token_lookahead() {
+    const char* input = "let x = 5;";
+    lexer::lexer l(input);
+    parser p(l);
+
+    assert_value(p.cur_type(), token::LET, "test_token_lookahead - cur type");
+    assert_value(p.peek_type(), token::IDENT, "test_token_lookahead - peek type");
+    assert_value(p.peek_type(3), token::INT, "test_token_lookahead - 3rd lookahead type");
+    assert_value(p.peek_type(5), token::EOFT, "test_token_lookahead - lookahead at end of input");
+    assert_value(p.peek_type(50), token::EOFT, "test_token_lookahead - lookahead past end of input");
+
+    std::cout<<"16 - ok: token lookahead."<<std::endl;
+}
+
+void test_node_spans() {
+    const char* input = "let x = 5;\nadd(x, 10);";
+    lexer::lexer l(input);
+    parser p(l);
+    ast::program* program = p.parse_program();
+    check_parser_errors(p);
+
+    auto ls = try_cast<const ast::let_statement>(program->statements()[0], "test_node_spans - not a let stmt.");
+    assert_value(ls->span().offset, 0, "test_node_spans - let offset");
+    assert_value(ls->span().length, 3, "test_node_spans - let length");
+    assert_value(ls->value()->span().offset, 8, "test_node_spans - int literal offset");
+
+    auto e = try_cast<const ast::expression_statement>(program->statements()[1], "test_node_spans - not an expr stmt.");
+    auto call = try_cast<const ast::call_expression>(e->expr(), "test_node_spans - not a call expr.");
+    assert_value(call->span().offset, 14, "test_node_spans - call offset");
+    assert_value(call->arguments()[1]->span().offset, 18, "test_node_spans - argument offset");
+    assert_value(call->arguments()[1]->span().length, 2, "test_node_spans - argument length");
+
+    lexer::lexer bad_l("let x = 5;\nlet = 10;");
+    parser bad_p(bad_l);
+    bad_p.parse_program();
+    assert_value(bad_p.errors()[0], "expected next token to be IDENT, got ASSIGN instead at 2:5.", 
+            "test_node_spans - error location");
+
+    std::cout<<"17 - ok: node spans."<<std::endl;
+}
+
+void test_loop_statements() {
+    lexer::lexer l("while (i < 10) { let i = i + 1; } for (x in [1, 2]) { x; }");
+    parser p(l);
+    std::unique_ptr<ast::program> program(p.parse_program());
+    check_parser_errors(p);
+    assert_value(program->statements().size(), 2, "test_loop_statements - statement count");
+
+    auto ws = try_cast<const ast::while_statement>(program->statements()[0], "test_loop_statements - not a while stmt.");
+    assert_value(ws->condition()->to_string(), "(i < 10)", "test_loop_statements - while condition");
+    assert_value(ws->body()->statements().size(), 1, "test_loop_statements - while body");
+
+    auto fs = try_cast<const ast::for_statement>(program->statements()[1], "test_loop_statements - not a for stmt.");
+    assert_value(fs->ident().value(), "x", "test_loop_statements - for variable");
+    assert_value(fs->iterable()->to_string(), "[1, 2]", "test_loop_statements - for iterable");
+    assert_value(fs->to_string(), "for(x in [1, 2]) x", "test_loop_statements - for to_string");
+
+    lexer::lexer semi_l("while (false) { }; for (x in []) { }; x");
+    parser semi_p(semi_l);
+    std::unique_ptr<ast::program> semi(semi_p.parse_program());
+    check_parser_errors(semi_p);
+    assert_value(semi->statements().size(), 3, "test_loop_statements - trailing semicolons");
+
+    lexer::lexer bad_l("for (x [1]) { x }");
+    parser bad_p(bad_l);
+    bad_p.parse_program();
+    assert_value(bad_p.errors()[0], "expected next token to be IN, got LBRACKET instead at 1:8.", 
+            "test_loop_statements - missing in");
+
+    std::cout<<"18 - ok: loop statements."<<std::endl;
+}
+
+void test_assign_expression() {
+    lexer::lexer l("x = 5; a[i + 1] = b = x * 2;");
+    parser p(l);
+    std::unique_ptr<ast::program> program(p.parse_program());
+    check_parser_errors(p);
+    assert_value(program->statements().size(), 2, "test_assign_expression - statement count");
+
+    auto es = try_cast<const ast::expression_statement>(program->statements()[0], "test_assign_expression - not an expr stmt.");
+    auto assign = try_cast<const ast::assign_expression>(es->expr(), "test_assign_expression - not an assignment.");
+    test_identifier(assign->target(), "x");
+    assert_value(assign->value()->to_string(), "5", "test_assign_expression - value");
+    assert_value(program->statements()[1]->to_string(), "((a[(i + 1)]) = (b = (x * 2)))", 
+            "test_assign_expression - right associative");
+
+    lexer::lexer bad_l("1 + 2 = 3;");
+    parser bad_p(bad_l);
+    bad_p.parse_program();
+    if(bad_p.errors().empty() || bad_p.errors()[0].rfind("cannot assign to (1 + 2)", 0) != 0) {
+        std::cout<<"fail: test_assign_expression - invalid target accepted"<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::cout<<"19 - ok: assignment expressions."<<std::endl;
+}
+
+void test_slice_expression() {
+    std::vector<std::pair<const char*, const char*>> tc {
+        {"a[1:2]", "(a[1:2])"},
+        {"a[:n - 1]", "(a[:(n - 1)])"},
+        {"a[i + 1:]", "(a[(i + 1):])"},
+        {"a[:]", "(a[:])"},
+        {"f(x)[1:][0]", "((f(x)[1:])[0])"},
+    };
+    for(const auto& [input, expected] : tc) {
+        lexer::lexer l(input);
+        parser p(l);
+        std::unique_ptr<ast::program> program(p.parse_program());
+        check_parser_errors(p);
+        assert_value(program->to_string(), expected, std::string("test_slice_expression - ") + input);
+    }
+    lexer::lexer l("a[1:2]");
+    parser p(l);
+    std::unique_ptr<ast::program> program(p.parse_program());
+    auto es = try_cast<const ast::expression_statement>(program->statements()[0], "test_slice_expression - not an expr stmt.");
+    auto slice = try_cast<const ast::slice_expression>(es->expr(), "test_slice_expression - not a slice.");
+    test_identifier(slice->left(), "a");
+    test_integer_literal(slice->begin(), 1);
+    test_integer_literal(slice->end(), 2);
+
+    std::cout<<"20 - ok: slice expressions."<<std::endl;
+}
+
+void test_hash_literal() {
+    std::vector<std::pair<const char*, const char*>> tc {
+        {"{}", "{}"},
+        {R"({"one": 1, "two": 2})", "{one: 1, two: 2}"},
+        {R"({1 + 1: a * 2, true: [1]})", "{(1 + 1): (a * 2), true: [1]}"},
+        {R"({"a": {"b": 1}}["a"])", "({a: {b: 1}}[a])"},
+    };
+    for(const auto& [input, expected] : tc) {
+        lexer::lexer l(input);
+        parser p(l);
+        std::unique_ptr<ast::program> program(p.parse_program());
+        check_parser_errors(p);
+        assert_value(program->to_string(), expected, std::string("test_hash_literal - ") + input);
+    }
+    lexer::lexer l(R"({"one": 1, x: 2})");
+    parser p(l);
+    std::unique_ptr<ast::program> program(p.parse_program());
+    auto es = try_cast<const ast::expression_statement>(program->statements()[0], "test_hash_literal - not an expr stmt.");
+    auto hash = try_cast<const ast::hash_literal>(es->expr(), "test_hash_literal - not a hash.");
+    assert_value(hash->pairs().size(), 2, "test_hash_literal - pair count");
+    test_identifier(hash->pairs()[1].first, "x");
+    test_integer_literal(hash->pairs()[1].second, 2);
+
+    for(const char* input : {R"({"one" 1})", R"({"one": 1 "two": 2})", R"({"one": 1,)"}) {
+        lexer::lexer bad_l(input);
+        parser bad_p(bad_l);
+        bad_p.parse_program();
+        if(bad_p.errors().empty()) {
+            std::cout<<"fail: test_hash_literal - accepted "<<input<<std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    std::cout<<"21 - ok: hash literals."<<std::endl;
+}
+
 } //namespace parser
 
 
@@ -600,6 +760,12 @@ int main(){
     parser::test_string_literal_expression();
     parser::test_parse_array_literal();
     parser::test_parse_index_expression();
+    parser::test_token_lookahead();
+    parser::test_node_spans();
+    parser::test_loop_statements();
+    parser::test_assign_expression();
+    parser::test_slice_expression();
+    parser::test_hash_literal();
 
     std::cout<<"parser_test.cpp: ok"<<std::endl;
 
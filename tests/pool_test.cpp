@@ -0,0 +1,101 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "../src/evaluator.hpp"
+#include "../src/parser.hpp"
+
+namespace object {
+
+template <typename T, typename V>
+void assert_value(const T& actual, const V& expected, std::string err_msg){
+    if(actual != expected) {
+        std::cout<<"fail: "<<err_msg<<" does not match. expected "<<expected<<" , got "<<actual<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+void test_reuse_freed_blocks() {
+    pool p;
+    void* a = p.allocate(sizeof(integer));
+    void* b = p.allocate(sizeof(integer));
+    assert_value(static_cast<char*>(b) - static_cast<char*>(a), pool::block_size(sizeof(integer)),
+            "test_reuse_freed_blocks - bump allocation");
+    assert_value(p.totals().live, 2, "test_reuse_freed_blocks - live blocks");
+
+    p.deallocate(a, sizeof(integer));
+    assert_value(p.totals().free, 1, "test_reuse_freed_blocks - free blocks");
+    assert_value(p.allocate(sizeof(integer)), a, "test_reuse_freed_blocks - free list pop");
+    assert_value(p.totals().free, 0, "test_reuse_freed_blocks - free blocks after reuse");
+
+    // a different size class does not see the freed block
+    p.deallocate(a, sizeof(integer));
+    void* c = p.allocate(sizeof(string));
+    assert_value(c == a, false, "test_reuse_freed_blocks - size classes");
+    assert_value(p.size_class_of(sizeof(integer)).free, 1, "test_reuse_freed_blocks - class stats");
+    std::cout<<"1 - ok: freed blocks are reused."<<std::endl;
+}
+
+void test_oversized_and_slabs() {
+    pool p;
+    void* big = p.allocate(pool::max_block + 1);
+    assert_value(p.totals().oversized, 1, "test_oversized_and_slabs - oversized");
+    assert_value(p.totals().slabs, 0, "test_oversized_and_slabs - no slab for oversized");
+    p.deallocate(big, pool::max_block + 1);
+    assert_value(p.totals().oversized, 0, "test_oversized_and_slabs - oversized freed");
+
+    std::size_t per_slab = pool::slab_size / pool::block_size(sizeof(scope));
+    for(std::size_t i = 0; i <= per_slab; i++) {
+        p.allocate(sizeof(scope));
+    }
+    assert_value(p.totals().slabs, 2, "test_oversized_and_slabs - slab refill");
+    std::cout<<"2 - ok: oversized blocks and slab refill."<<std::endl;
+}
+
+void test_evaluator_uses_pool() {
+    const char* input = "let add = fn(x, y) { x + y }; add(1, 2) + add(3, 4);";
+    lexer::lexer l(input);
+    parser::parser p(l);
+    std::shared_ptr<ast::program> program(p.parse_program());
+
+    pool::stats before = pool::local().totals();
+    object* res = evaluator::eval(program, new scope());
+    pool::stats after = pool::local().totals();
+    assert_value(res->inspect(), "10", "test_evaluator_uses_pool - result");
+    if(after.live <= before.live) {
+        std::cout<<"fail: test_evaluator_uses_pool - no blocks allocated from the pool"<<std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    integer* i = new integer(7);
+    assert_value(pool::local().totals().live, after.live + 1, "test_evaluator_uses_pool - operator new");
+    destroy(i);
+    assert_value(pool::local().totals().live, after.live, "test_evaluator_uses_pool - destroy");
+
+    // each thread allocates from its own pool
+    std::size_t other_live = 0;
+    std::thread t([&] {
+        new integer(1);
+        other_live = pool::local().totals().live;
+    });
+    t.join();
+    assert_value(other_live, 1, "test_evaluator_uses_pool - thread local pool");
+    std::cout<<"3 - ok: evaluator allocates from the thread's pool."<<std::endl;
+}
+
+} // namespace object
+
+size_t parser::trace::_indent_level = 0;
+bool parser::trace::_enable_trace = 0;
+
+int main() {
+    std::cout<<"Running pool_test.cpp..."<<std::endl;
+
+    object::test_reuse_freed_blocks();
+    object::test_oversized_and_slabs();
+    object::test_evaluator_uses_pool();
+
+    std::cout<<"pool_test.cpp: ok"<<std::endl;
+
+    exit(EXIT_SUCCESS);
+}